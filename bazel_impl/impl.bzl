@@ -96,19 +96,60 @@ def _find_cc_info(ctx, cc_source_file, cc_deps, copts):
     return struct(
         compiler_path = c_compiler_path,
         command_line = _make_includes_rel_to_rundir(ctx, command_line),
+        # as run from the execroot, for build-time actions
+        exec_command_line = command_line,
         env = env,
-        # Not sure if all_files is needed or if just compiler/compiler_executable could somehow be listed
-        toolchain_files = cc_toolchain.all_files.to_list(),
+        # the compiler and its builtin headers - not the linker, archiver, etc of all_files
+        toolchain_files = cc_toolchain.compiler_files,
+        dep_headers = deps_ctx.headers,
     )
 
-def _find_dep_headers(cc_deps):
-    """Finds all public headers of all passed in deps"""
+def _prefix_include_dirs(command_line, prefix):
+    """Move relative -I/-iquote/-isystem dirs under prefix - where _scan_includes staged their headers"""
 
-    dep_headers = []
-    for dep in cc_deps:
-        dep_headers.extend(dep[CcInfo].compilation_context.direct_public_headers)
+    include_flags = ["-I", "-iquote", "-isystem"]
 
-    return dep_headers
+    prefixed = []
+    prefix_next = False
+    for arg in command_line:
+        if prefix_next and not arg.startswith("/"):
+            arg = prefix + "/" + arg
+        prefix_next = arg in include_flags
+
+        if arg.startswith("-I") and len(arg) > 2 and not arg[2:].startswith("/"):
+            arg = "-I" + prefix + "/" + arg[2:]
+
+        prefixed.append(arg)
+
+    return prefixed
+
+def _scan_includes(ctx, cc_info, source_file):
+    """Stage just the headers source_file includes, found with -M at build time
+
+    Staging every transitive dep header (and the whole toolchain) means a sandboxed test run has to create thousands of
+    symlinks before it compiles anything - often more time than the compiles themselves take.  The source's cases can't
+    include anything the source doesn't, so the source's own -M output lists everything a case compile reads.
+
+    Headers are copied into a tree artifact at their execroot paths (less the bin dir, as for include flags), so the
+    test's include flags need only be moved under it - see _prefix_include_dirs.
+    """
+    deps_file = ctx.actions.declare_file(ctx.label.name + ".d")
+    headers = ctx.actions.declare_directory(ctx.label.name + ".headers")
+
+    # the compile's output becomes the dependency rule
+    scan_args = [deps_file.path if arg == "dummy_output.o" else arg for arg in cc_info.exec_command_line] + ["-M"]
+
+    ctx.actions.run(
+        executable = ctx.executable._include_scan,
+        arguments = [deps_file.path, headers.path, ctx.bin_dir.path, cc_info.compiler_path] + scan_args,
+        inputs = depset([source_file], transitive = [cc_info.dep_headers, cc_info.toolchain_files]),
+        outputs = [deps_file, headers],
+        env = cc_info.env,
+        mnemonic = "CompTestIncludeScan",
+        progress_message = "Scanning includes of %s" % source_file.short_path,
+    )
+
+    return headers
 
 def _impl_runner_cc_comp_test(ctx):
     """Impl of rule to build the test runner for testing compile time asserts
@@ -127,6 +168,7 @@ def _impl_runner_cc_comp_test(ctx):
     copts = ctx.attr.copts
 
     cc_info = _find_cc_info(ctx, cc_source_file = cc_source_file, cc_deps = cc_deps, copts = copts)
+    headers = _scan_includes(ctx, cc_info = cc_info, source_file = source_file)
 
     # See https://bazel.build/reference/test-encyclopedia#test-sharding
     # Can shard runs at runtime - threading
@@ -138,16 +180,15 @@ def _impl_runner_cc_comp_test(ctx):
             "{INFO_BINARY}": info_binary.short_path,
             "{COMPILER_PATH}": cc_info.compiler_path,
             "{SOURCE_FILE}": source_file.short_path,
-            "{ARGS}": " ".join(cc_info.command_line),
+            "{ARGS}": " ".join(_prefix_include_dirs(cc_info.command_line, headers.short_path)),
         },
         output = output_file,
         is_executable = True,
     )
 
-    dep_headers = _find_dep_headers(cc_deps = cc_deps)
-
     runfiles = ctx.runfiles(
-        files = dep_headers + cc_info.toolchain_files + [test_runner, source_file, info_binary],
+        files = [headers, test_runner, source_file, info_binary],
+        transitive_files = cc_info.toolchain_files,
     )
 
     # TODO sharding: https://bazel.build/reference/test-encyclopedia#test-sharding
@@ -202,6 +243,13 @@ _runner_cc_comp_test = rule(
             providers = [CcInfo],
             doc = "Implicit arg - the actual test runner - runs the test cases in 'src', validates results, and writes junit XML.  Wrapped by '_test_runner_wrapper'",
         ),
+        "_include_scan": attr.label(
+            default = "include_scan.sh",
+            allow_single_file = True,
+            executable = True,
+            cfg = "exec",
+            doc = "Implicit arg - lists the headers 'src' includes, and stages just those for the test's runfiles",
+        ),
         "_test_runner_wrapper": attr.label(
             allow_single_file = True,
             default = "test.sh.tpl",
@@ -213,7 +261,7 @@ _runner_cc_comp_test = rule(
     test = True,
 )
 
-def cc_comp_test(name, src = None, copts = [], deps = []):
+def cc_comp_test(name, src = None, copts = [], deps = [], **kwargs):
     """Define a C++ compile time test
 
     Just like cc_test() but for testing compile time behaviour like static_assert().
@@ -231,6 +279,7 @@ def cc_comp_test(name, src = None, copts = [], deps = []):
         src:    The source file containing compile time test cases.  Optional - if omitted, '{name}.cc' is used instead
         copts:  C flags - same as copts in cc_binary and other rules
         deps:   Dependencies of src - other cc_library()'s, etc.  Usually the library you are writing compile time test cases for
+        **kwargs:   Common test attributes - args, tags, size, timeout, etc.  Passed to the test rule, with tags also applied to the info binary
     """
     src = src if src else name + ".cc"
 
@@ -241,6 +290,7 @@ def cc_comp_test(name, src = None, copts = [], deps = []):
         copts = copts,
         srcs = [src],
         deps = deps + ["//lib:comp_test", "//info_binary:info_binary_main"],
+        tags = kwargs.get("tags", []),
     )
 
     _runner_cc_comp_test(
@@ -249,4 +299,5 @@ def cc_comp_test(name, src = None, copts = [], deps = []):
         deps = deps,
         copts = copts,
         info_binary = info_binary,
+        **kwargs
     )
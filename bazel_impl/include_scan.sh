@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+
+# Stage the headers a source includes into a tree artifact, so a
+# cc_comp_test's runfiles hold just those rather than every dep header
+#
+# usage: include_scan.sh <deps file> <out dir> <bin dir> <compiler> <args...>
+#
+# args must write the compile's output to <deps file>, with -M - the rule
+# that lists every file the source includes.  Each relative path in it is
+# copied under <out dir>, with <bin dir>/ stripped as it is from the test's
+# include flags.  Absolute paths are system headers, left where they are.
+
+set -euo pipefail
+
+deps="$1"
+out="$2"
+bin_dir="$3"
+shift 3
+
+"$@"
+
+mkdir -p "$out"
+
+# drop the rule's target and line continuations, then one path per line
+sed -e '1s/^[^:]*: *//' -e 's/\\$//' "$deps" | tr -s ' \t' '\n\n' |
+    while read -r path; do
+        if [[ -z "$path" || "$path" == /* ]]; then
+            continue
+        fi
+
+        dest="$out/${path#"$bin_dir"/}"
+        mkdir -p "$(dirname "$dest")"
+        cp -L "$path" "$dest"
+    done
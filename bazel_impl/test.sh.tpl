@@ -12,4 +12,4 @@ if [[ "${TEST_TMPDIR-}" != "" ]]; then
     extra_flags+=("-t", "$TEST_TMPDIR")
 fi
 
-{TEST_RUNNER} -i "{INFO_BINARY}" -s "{SOURCE_FILE}" -c "{COMPILER_PATH}" -j "$JUNIT" "${extra_flags[*]}" --no-colour -- {ARGS}
\ No newline at end of file
+{TEST_RUNNER} -i "{INFO_BINARY}" -s "{SOURCE_FILE}" -c "{COMPILER_PATH}" -j "$JUNIT" "${extra_flags[*]}" --no-colour "$@" -- {ARGS}
\ No newline at end of file
@@ -0,0 +1,40 @@
+load("//:cc_comp_test.bzl", "cc_comp_test")
+
+def scale_benchmark(name, cases, fail = 0, error = 0, diagnostics = 1, copts = []):
+    """A cc_comp_test over a generated source, for measuring how the runner scales
+
+    The runner writes run_stats.json (wall time, compiler invocations, runner CPU
+    time and peak RSS) to the test's undeclared outputs.  Targets are tagged
+    manual - they are slow, and any failing/erroring cases make the test fail by design.
+
+    Args:
+        name:           Name of the cc_comp_test target
+        cases:          Number of test cases to generate
+        fail:           Percent of cases that fail
+        error:          Percent of cases that error
+        diagnostics:    static_asserts fired per asserting case - controls diagnostic volume
+        copts:          Additional copts
+    """
+    src = name + ".cc"
+
+    native.genrule(
+        name = name + "_src",
+        outs = [src],
+        cmd = "$(location //benchmark:generate_cases) --cases {} --fail {} --error {} --diagnostics {} > $@".format(
+            cases,
+            fail,
+            error,
+            diagnostics,
+        ),
+        tools = ["//benchmark:generate_cases"],
+        tags = ["manual"],
+    )
+
+    cc_comp_test(
+        name = name,
+        src = src,
+        copts = ["-std=c++11", "-ferror-limit=0"] + copts,
+        args = ["--stats=run_stats.json"],
+        tags = ["manual", "benchmark"],
+        timeout = "eternal",
+    )
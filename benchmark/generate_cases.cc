@@ -0,0 +1,169 @@
+// Generates a synthetic comp_test source file for benchmarking the runner
+//
+// generate_cases --cases N [--fail PERCENT] [--error PERCENT]
+//                [--diagnostics N] [--suite-size N]
+//
+// Cases are spread over TEST_SUITEs like sample/sample.cc.  Passing cases
+// alternate between MUST_STATIC_ASSERT and MUST_COMPILE, failing cases are
+// MUST_COMPILE cases that static_assert, and erroring cases call an undeclared
+// function.  Every asserting case fires --diagnostics separate static_asserts,
+// each with its own instantiation notes - compile with -ferror-limit=0 (clang)
+// or -fmax-errors=0 (gcc) to keep them all.
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct options {
+    unsigned long cases = 10;
+    unsigned long fail_percent = 0;
+    unsigned long error_percent = 0;
+    unsigned long diagnostics = 1;
+    unsigned long suite_size = 50;
+};
+
+options parse(int argc, char **argv) {
+    options opts;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            throw std::runtime_error{"missing value for " + arg};
+        }
+
+        auto value = std::stoul(argv[++i]);
+
+        if (arg == "--cases") {
+            opts.cases = value;
+        } else if (arg == "--fail") {
+            opts.fail_percent = value;
+        } else if (arg == "--error") {
+            opts.error_percent = value;
+        } else if (arg == "--diagnostics") {
+            opts.diagnostics = value;
+        } else if (arg == "--suite-size") {
+            opts.suite_size = value;
+        } else {
+            throw std::runtime_error{"unknown option " + arg};
+        }
+    }
+
+    if (opts.fail_percent + opts.error_percent > 100) {
+        throw std::runtime_error{"--fail + --error must be <= 100"};
+    }
+
+    if (opts.diagnostics == 0) {
+        throw std::runtime_error{"--diagnostics must be > 0"};
+    }
+
+    if (opts.suite_size == 0) {
+        throw std::runtime_error{"--suite-size must be > 0"};
+    }
+
+    return opts;
+}
+
+enum class outcome {
+    pass,
+    fail,
+    error,
+};
+
+// spread failing and erroring cases evenly through the file, rather than
+// bunching them at the end
+outcome outcome_for(const options &opts, unsigned long i) {
+    auto bucket = (i * 37) % 100;
+
+    if (bucket < opts.fail_percent) {
+        return outcome::fail;
+    }
+
+    if (bucket < opts.fail_percent + opts.error_percent) {
+        return outcome::error;
+    }
+
+    return outcome::pass;
+}
+
+// calls to --diagnostics distinct instantiations of spam<N, T>
+std::string spam_calls(const options &opts, const char *type) {
+    std::string calls;
+
+    for (unsigned long n = 1; n <= opts.diagnostics; n++) {
+        calls += "        spam<" + std::to_string(n) + ", " + type + ">();\n";
+    }
+
+    return calls;
+}
+
+void write_case(std::ostream &out, const options &opts, unsigned long i) {
+    switch (outcome_for(opts, i)) {
+        case outcome::pass:
+            if (i % 2 == 0) {
+                out << "    MUST_STATIC_ASSERT(\"spam\", \"asserts " << i
+                    << "\", \"not integral\") {\n"
+                    << spam_calls(opts, "const char *") << "    }\n";
+            } else {
+                out << "    MUST_COMPILE(\"spam\", \"compiles " << i
+                    << "\") {\n"
+                    << spam_calls(opts, "int") << "    }\n";
+            }
+            break;
+        case outcome::fail:
+            out << "    MUST_COMPILE(\"spam\", \"fails " << i << "\") {\n"
+                << spam_calls(opts, "const char *") << "    }\n";
+            break;
+        case outcome::error:
+            out << "    MUST_COMPILE(\"spam\", \"errors " << i << "\") {\n"
+                << "        undeclared_" << i << "(TestCase::line);\n"
+                << "    }\n";
+            break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    options opts;
+
+    try {
+        opts = parse(argc, argv);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "// generated by //benchmark:generate_cases - " << opts.cases
+              << " cases\n\n"
+              << R"(#include <type_traits>
+
+#include "comp_test/comp_test.hh"
+
+// each N is its own instantiation, so each fires its own static_assert
+template <int N, typename T>
+void spam() {
+    static_assert(std::is_integral<T>::value, "not integral");
+}
+
+)";
+
+    for (unsigned long i = 0; i < opts.cases; i++) {
+        if (i % opts.suite_size == 0) {
+            std::cout << "TEST_SUITE(\"generated\", \"suite "
+                      << i / opts.suite_size << "\") {\n";
+        }
+
+        write_case(std::cout, opts, i);
+
+        if (i % opts.suite_size == opts.suite_size - 1
+            || i + 1 == opts.cases) {
+            std::cout << "}\n\n";
+        }
+    }
+
+    return 0;
+}
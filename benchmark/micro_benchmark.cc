@@ -0,0 +1,124 @@
+// Microbenchmarks for the runner code that runs once per line or per case
+//
+// bazel run -c opt //benchmark:micro_benchmark -- --benchmark_format=json
+//
+// Inputs are read from the checked in corpus/ - real info binary output,
+// clang and gcc diagnostics, and a Bazel compile command line
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "comp_test/comp_test_info.hh"
+#include "test_runner/compiler.hh"
+
+namespace {
+
+namespace ct = dhagedorn::comp_test;
+namespace impl = dhagedorn::comp_test::impl;
+
+std::vector<std::string> read_lines(const std::string &name) {
+    std::ifstream fin{"benchmark/corpus/" + name};
+
+    if (!fin.is_open()) {
+        throw std::runtime_error{"could not open corpus " + name};
+    }
+
+    std::vector<std::string> lines;
+
+    for (std::string line; std::getline(fin, line);) {
+        lines.push_back(line);
+    }
+
+    return lines;
+}
+
+/** lines of the info binary output starting with prefix, prefix removed */
+std::vector<std::string> info_lines(const std::string &prefix) {
+    std::vector<std::string> lines;
+
+    for (auto &line : read_lines("info_output.txt")) {
+        if (line.rfind(prefix, 0) == 0) {
+            lines.push_back(line.substr(prefix.size()));
+        }
+    }
+
+    return lines;
+}
+
+void putter_getter_round_trip(benchmark::State &state) {
+    auto tc = ct::test_case::from_string(info_lines("test_case:").at(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ct::test_case::from_string(tc.to_string()));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(putter_getter_round_trip);
+
+void test_case_from_string(benchmark::State &state) {
+    auto lines = info_lines("test_case:");
+
+    for (auto _ : state) {
+        for (auto &line : lines) {
+            benchmark::DoNotOptimize(ct::test_case::from_string(line));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(test_case_from_string);
+
+void test_suite_from_string(benchmark::State &state) {
+    auto lines = info_lines("test_suite:");
+
+    for (auto _ : state) {
+        for (auto &line : lines) {
+            benchmark::DoNotOptimize(ct::test_suite::from_string(line));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(test_suite_from_string);
+
+void compiler_diagnostic_from_string(benchmark::State &state,
+                                     const std::string &corpus) {
+    auto lines = read_lines(corpus);
+
+    for (auto _ : state) {
+        for (auto &line : lines) {
+            benchmark::DoNotOptimize(
+                impl::compiler_diagnostic::from_string(line));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK_CAPTURE(compiler_diagnostic_from_string,
+                  clang,
+                  std::string{"clang_diagnostics.txt"});
+BENCHMARK_CAPTURE(compiler_diagnostic_from_string,
+                  gcc,
+                  std::string{"gcc_diagnostics.txt"});
+
+void compiler_rewrite_args(benchmark::State &state) {
+    auto args = read_lines("bazel_command_line.txt");
+    auto comp = impl::compiler{"clang", args};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            comp.rewrite_args(args, "/tmp/input.cc", "/tmp/output.o"));
+    }
+
+    state.SetItemsProcessed(state.iterations() * args.size());
+}
+BENCHMARK(compiler_rewrite_args);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+
+# Runs the //benchmark:scale targets and prints one JSON object per target, tagged with
+# the current commit, ex:
+#
+#   benchmark/run_scale.sh >> scale_results.jsonl
+#
+# Run from the workspace root.  Extra arguments are passed to `bazel test`.
+
+set -euo pipefail
+
+commit="$(git rev-parse HEAD)"
+
+# cases that fail or error by design make the targets fail - the stats are still written
+bazel test --nozip_undeclared_test_outputs --cache_test_results=no "$@" //benchmark:scale >&2 || true
+
+testlogs="$(bazel info bazel-testlogs)"
+
+for stats in "$testlogs"/benchmark/scale_*/test.outputs/run_stats.json; do
+    target="$(basename "$(dirname "$(dirname "$stats")")")"
+
+    printf '{"commit": "%s", "target": "%s", "stats": %s}\n' \
+        "$commit" "$target" "$(tr -d '\n' < "$stats")"
+done
@@ -1,5 +1,5 @@
 
-#include "comp_test/comp_test.hh"
+#include "comp_test/comp_test_info.hh"
 
 int main(int argc, char **argv) {
     std::cout << "info binary - lists test cases and suites\n";
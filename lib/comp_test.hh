@@ -1,14 +1,14 @@
 #pragma once
 
-#include <cstdlib>
-#include <functional>
-#include <iostream>
-#include <regex>
-#include <sstream>
-#include <stdexcept>
-#include <string>
-#include <type_traits>
-#include <vector>
+/**
+ * Test case registration - the only header a test source includes
+ *
+ * This is compiled into every test source, and into every case compile the
+ * runner does, so it includes nothing: cases are registered as static
+ * records of string literals, in a list.  Reading them back - serialization
+ * for the runner, parsing, suite lookup - is in comp_test_info.hh, used only
+ * by the info binary and the runner.
+ */
 
 #ifdef _MSC_VER
 #define __PRETTY_FUNCTION__ __FUNCSIG__
@@ -25,7 +25,7 @@ template <typename T>
 struct required {
     template <typename _T>
     required(_T &&v)
-        : value{std::forward<_T>(v)} {}
+        : value(static_cast<_T &&>(v)) {}
 
     operator T &() { return value; }
 
@@ -33,45 +33,48 @@ struct required {
 };
 
 struct test_suite_args {
-    required<std::string> name;
-    required<std::string> description;
+    required<const char *> name;
+    required<const char *> description;
 };
 
 #define TEST_SUITE(...)                                                        \
     static auto EXPAND_CALL(JOIN, _test_suite_define, __LINE__) = [] {         \
         test_suite_args args{__VA_ARGS__};                                     \
-        dhagedorn::comp_test::_test_suites().push_back({                       \
+        static dhagedorn::comp_test::suite_record record{                      \
             __FILE__,                                                          \
             __LINE__,                                                          \
             EXPAND_CALL(STRINGIFY, UNIQUE_SYMBOL(_test_suite_)),               \
-            std::move(args.name),                                              \
-            std::move(args.description),                                       \
-        });                                                                    \
-                                                                               \
-        return 0;                                                              \
+            args.name,                                                         \
+            args.description,                                                  \
+            nullptr,                                                           \
+        };                                                                     \
+        return dhagedorn::comp_test::_register(record);                        \
     }();                                                                       \
     namespace UNIQUE_SYMBOL(_test_suite_)
 
 struct comp_assert_args {
-    required<std::string> object;
-    required<std::string> will;
-    required<std::string> assert_with;
+    required<const char *> object;
+    required<const char *> will;
+    required<const char *> assert_with;
 }; // namespace comp_assert_args
 
 #define IMPL(TYPE, ...)                                                        \
     static auto EXPAND_CALL(JOIN, _comp_test_define, __LINE__) = [] {          \
         comp_assert_args args{__VA_ARGS__};                                    \
-        std::string pretty = std::string{__PRETTY_FUNCTION__};                 \
-        dhagedorn::comp_test::_test_cases().push_back(                         \
-            {__FILE__,                                                         \
-             __LINE__,                                                         \
-             __PRETTY_FUNCTION__,                                              \
-             EXPAND_CALL(STRINGIFY, UNIQUE_SYMBOL(_test_case_)),               \
-             std::move(args.object),                                           \
-             std::move(args.will),                                             \
-             std::move(args.assert_with),                                      \
-             TYPE});                                                           \
-        return 0;                                                              \
+        static dhagedorn::comp_test::case_record record{                       \
+            __FILE__,                                                          \
+            __LINE__,                                                          \
+            __PRETTY_FUNCTION__,                                               \
+            EXPAND_CALL(STRINGIFY, UNIQUE_SYMBOL(_test_case_)),                \
+            args.object,                                                       \
+            args.will,                                                         \
+            args.assert_with,                                                  \
+            TYPE,                                                              \
+            false,                                                             \
+            "",                                                                \
+            nullptr,                                                           \
+        };                                                                     \
+        return dhagedorn::comp_test::_register(record);                        \
     }();                                                                       \
     template <typename TestCase>                                               \
     static void UNIQUE_SYMBOL(_test_case_)()
@@ -81,109 +84,125 @@ struct comp_assert_args {
 #define MUST_COMPILE(...)                                                      \
     IMPL(dhagedorn::comp_test::test_type::MUST_COMPILE, __VA_ARGS__, "")
 
-namespace dhagedorn {
-namespace comp_test {
-
-namespace detail {
-
-class putter {
-public:
-    std::string str() {
-        auto as_str = buf.str();
-        auto len = as_str.size() > 0 ? as_str.size() - 1 : 0;
-
-        return as_str.substr(0, len);
-    }
-
-    template <typename T>
-    void operator()(T &&value) {
-        buf << escape(value) << ":";
-    }
-
-private:
-    std::string escape(const std::string &value) const {
-        auto escaped = value;
-
-        escaped = std::regex_replace(escaped, std::regex{":"}, R"(\:)");
-        escaped = std::regex_replace(escaped, std::regex{"\n"}, R"(\n)");
-
-        return escaped;
-    }
-
-    template <typename T>
-    const T &escape(const T &value) const {
-        return value;
-    }
-
-    std::stringstream buf;
-};
-
-struct getter {
-public:
-    getter(const std::string &value)
-        : _value{value} {}
-
-    std::string operator()() {
-        std::stringstream token;
-        char c;
-
-        while (take(c)) {
-            if (c == ':' || c == '\n') {
-                break;
-            }
-
-            if (c != '\\') {
-                token << c;
-                continue;
-            }
-
-            if (!take(c)) {
-                continue;
-            }
-
-            if (c == 'n') {
-                token << '\n';
-                continue;
-            }
-
-            token << c;
-        }
-
-        return token.str();
-    };
-
-private:
-    unsigned _i = 0;
-    std::string _value;
-
-    bool take(char &out) {
-        if (_i >= _value.size()) {
-            return false;
-        }
-
-        out = _value[_i++];
-        return true;
-    };
-};
+// A case compiled and measured by the runner - LIMITS are the rest of the
+// macro's arguments, stringified, for the runner to parse
+#define LIMITS_IMPL(TYPE, OBJECT, WILL, LIMITS)                                \
+    static auto EXPAND_CALL(JOIN, _comp_test_define, __LINE__) = [] {          \
+        static dhagedorn::comp_test::case_record record{                       \
+            __FILE__,                                                          \
+            __LINE__,                                                          \
+            __PRETTY_FUNCTION__,                                               \
+            EXPAND_CALL(STRINGIFY, UNIQUE_SYMBOL(_test_case_)),                \
+            OBJECT,                                                            \
+            WILL,                                                              \
+            "",                                                                \
+            TYPE,                                                              \
+            false,                                                             \
+            LIMITS,                                                            \
+            nullptr,                                                           \
+        };                                                                     \
+        return dhagedorn::comp_test::_register(record);                        \
+    }();                                                                       \
+    template <typename TestCase>                                               \
+    static void UNIQUE_SYMBOL(_test_case_)()
 
-// clang-format off
-    // clang: "auto namespace_name::(anonymous class)::operator()() const"
-    // gcc: "namespace_name::<lambda()>\000"
-    // msvc: "auto __cdecl namespace_name::<lambda_676ec28c60ffff024507b007ccd4a443>::operator()(void) const"
-    // For no NS = remove "namespace_name::"
-// clang-format on
-inline std::string namespace_name(const std::string &symbol) {
-    std::regex reg{R"_(([\w\d_]+)::(\(anonymous|<lambda))_"};
-
-    std::smatch match;
-    if (std::regex_search(symbol, match, reg)) {
-        return match[1].str();
-    }
-
-    return "";
-}
+// COMP_SCALING(object, will, bound[, sizes...]) - the body is compiled once
+// per size, as TestCase::size, and its compile time must grow no faster than
+// bound: constant, logarithmic, linear, linearithmic, quadratic or cubic.
+// Sizes are 16, 64, 256, 1024 if none are given
+#define COMP_SCALING(OBJECT, WILL, ...)                                        \
+    LIMITS_IMPL(dhagedorn::comp_test::test_type::COMP_SCALING,                 \
+                OBJECT,                                                        \
+                WILL,                                                          \
+                #__VA_ARGS__)
+
+// COMP_BUDGET(object, will, instantiations(n), constexpr_steps(n)) - either
+// or both.  The body must compile, adding no more than n template
+// instantiations to the source's own, and with no constant evaluation taking
+// more than n steps.  Unlike compile times, these counts never flake
+#define COMP_BUDGET(OBJECT, WILL, ...)                                         \
+    LIMITS_IMPL(dhagedorn::comp_test::test_type::COMP_BUDGET,                  \
+                OBJECT,                                                        \
+                WILL,                                                          \
+                #__VA_ARGS__)
+
+// COMP_CODE_SIZE(object, will, bytes) - the body must compile, adding no
+// more than bytes of executable code to the source's own object.  The
+// object must be ELF, so not with -flto
+#define COMP_CODE_SIZE(OBJECT, WILL, ...)                                      \
+    LIMITS_IMPL(dhagedorn::comp_test::test_type::COMP_CODE_SIZE,               \
+                OBJECT,                                                        \
+                WILL,                                                          \
+                #__VA_ARGS__)
+
+// MUST_VECTORIZE(object, will) - the body must compile, and every loop
+// written in it must be vectorized, one at least.  Needs the source compiled
+// with optimization
+#define MUST_VECTORIZE(OBJECT, WILL)                                           \
+    LIMITS_IMPL(                                                               \
+        dhagedorn::comp_test::test_type::MUST_VECTORIZE, OBJECT, WILL, "")
+
+// MUST_INLINE(object, will) - the body must compile, and every call written
+// in it must be inlined, one at least - calls to functions with no
+// definition to inline aside
+#define MUST_INLINE(OBJECT, WILL)                                              \
+    LIMITS_IMPL(dhagedorn::comp_test::test_type::MUST_INLINE, OBJECT, WILL, "")
+
+// MUST_NOT_REFERENCE(object, will, symbols...) - the body must compile, with
+// optimization, into code that calls none of symbols, ex operator new,
+// malloc, __cxa_throw.  The object must be ELF, as for COMP_CODE_SIZE
+#define MUST_NOT_REFERENCE(OBJECT, WILL, ...)                                  \
+    LIMITS_IMPL(dhagedorn::comp_test::test_type::MUST_NOT_REFERENCE,           \
+                OBJECT,                                                        \
+                WILL,                                                          \
+                #__VA_ARGS__)
+
+// The check is the trait's partial specialization - well_formed is decided
+// while the info binary compiles, and the runner compiles nothing for it
+#define VALIDITY_IMPL(TYPE, OBJECT, WILL, CHECKED_TYPE, ...)                   \
+    template <typename T, typename = void>                                     \
+    struct UNIQUE_SYMBOL(_validity_check_) {                                   \
+        static constexpr bool value = false;                                   \
+    };                                                                         \
+    template <typename T>                                                      \
+    struct UNIQUE_SYMBOL(_validity_check_)<T,                                  \
+                                           decltype((__VA_ARGS__), void())> {  \
+        static constexpr bool value = true;                                    \
+    };                                                                         \
+    static auto EXPAND_CALL(JOIN, _comp_test_define, __LINE__) = [] {          \
+        static dhagedorn::comp_test::case_record record{                       \
+            __FILE__,                                                          \
+            __LINE__,                                                          \
+            __PRETTY_FUNCTION__,                                               \
+            EXPAND_CALL(STRINGIFY, UNIQUE_SYMBOL(_test_case_)),                \
+            OBJECT,                                                            \
+            WILL,                                                              \
+            "",                                                                \
+            TYPE,                                                              \
+            UNIQUE_SYMBOL(_validity_check_)<CHECKED_TYPE>::value,              \
+            "",                                                                \
+            nullptr,                                                           \
+        };                                                                     \
+        return dhagedorn::comp_test::_register(record);                        \
+    }()
+
+// MUST_BE_VALID(object, will, type, expression using T) - expression must be
+// well-formed with T = type.  Wrap types containing commas in an alias
+#define MUST_BE_VALID(OBJECT, WILL, CHECKED_TYPE, ...)                         \
+    VALIDITY_IMPL(dhagedorn::comp_test::test_type::MUST_BE_VALID,              \
+                  OBJECT,                                                      \
+                  WILL,                                                        \
+                  CHECKED_TYPE,                                                \
+                  __VA_ARGS__)
+#define MUST_BE_INVALID(OBJECT, WILL, CHECKED_TYPE, ...)                       \
+    VALIDITY_IMPL(dhagedorn::comp_test::test_type::MUST_BE_INVALID,            \
+                  OBJECT,                                                      \
+                  WILL,                                                        \
+                  CHECKED_TYPE,                                                \
+                  __VA_ARGS__)
 
-} // namespace detail
+namespace dhagedorn {
+namespace comp_test {
 
 /**
  * template for TestCase type passed as the first, hidden, template type
@@ -205,144 +224,71 @@ struct TestCase {
         = "original name of file this test case is defined in";
     static constexpr unsigned line
         = 0; // original line number this test case is defined on;
+    static constexpr unsigned long size
+        = 0; // COMP_SCALING only - the size this compile is for
 };
 
 enum class test_type {
     MUST_STATIC_ASSERT,
     MUST_COMPILE,
+    MUST_BE_VALID,
+    MUST_BE_INVALID,
+    COMP_SCALING,
+    COMP_BUDGET,
+    COMP_CODE_SIZE,
+    MUST_VECTORIZE,
+    MUST_INLINE,
+    MUST_NOT_REFERENCE,
 };
 
-using test_type_raw = std::underlying_type<test_type>::type;
-
-constexpr inline test_type_raw to_number(test_type value) {
-    return static_cast<test_type_raw>(value);
-}
-
-inline test_type from_number(test_type_raw value) {
-    switch (value) {
-        case to_number(test_type::MUST_STATIC_ASSERT):
-            return test_type::MUST_STATIC_ASSERT;
-        case to_number(test_type::MUST_COMPILE):
-            return test_type::MUST_COMPILE;
-    }
-
-    throw std::runtime_error{"invalid value for test_type"};
-}
-
-struct test_suite {
-    std::string file;
+/** a TEST_SUITE, as registered - see test_suite for what each field is */
+struct suite_record {
+    const char *file;
     unsigned long line;
-    std::string symbol;
-    std::string name;
-    std::string description;
-
-    std::string to_string() const {
-        detail::putter put;
-
-        put(file);
-        put(line);
-        put(symbol);
-        put(name);
-        put(description);
-
-        return put.str();
-    }
-
-    static test_suite from_string(const std::string &value) {
-        detail::getter get{value};
-
-        try {
-            return test_suite{
-                get(),
-                std::stoul(get()),
-                get(),
-                get(),
-                get(),
-            };
-        } catch (std::exception &exception) {
-            std::cerr << exception.what() << std::endl;
-            throw exception;
-        }
-    }
-
-    bool operator==(const test_suite &rhs) const {
-        return file == rhs.file && line == rhs.line;
-    }
+    const char *symbol;
+    const char *name;
+    const char *description;
+    suite_record *next;
 };
 
-struct test_case {
-    std::string file;
+/** a test case, as registered - see test_case for what each field is */
+struct case_record {
+    const char *file;
     unsigned long line;
-
-    // "namespace"
-    std::string detailed_name;
-    std::string symbol;
-    std::string object;
-    std::string verb;
-    std::string expected_assert_message;
+    const char *detailed_name;
+    const char *symbol;
+    const char *object;
+    const char *verb;
+    const char *expected_assert_message;
     test_type type;
+    bool well_formed;
+    const char *limits;
+    case_record *next;
+};
 
-    std::string to_string() const {
-        detail::putter put;
-
-        put(file);
-        put(line);
-        put(detailed_name);
-        put(symbol);
-        put(object);
-        put(verb);
-        put(expected_assert_message);
-        put(to_number(type));
-
-        return put.str();
-    }
-
-    std::string test_suite_symbol() const {
-        return detail::namespace_name(detailed_name);
-    }
-
-    static test_case from_string(const std::string &value) {
-        detail::getter get{value};
-
-        try {
-            return test_case{
-                get(),
-                std::stoul(get()),
-                get(),
-                get(),
-                get(),
-                get(),
-                get(),
-                from_number(std::stoul(get())),
-            };
-        } catch (std::exception &exception) {
-            std::cerr << exception.what() << std::endl;
-            throw exception;
-        }
-    }
+/** records in registration order - linked through their next pointers */
+template <typename RECORD>
+struct record_list {
+    RECORD *first;
+    RECORD *last;
 };
 
-inline std::vector<test_case> &_test_cases() {
-    static std::vector<test_case> store;
-    return store;
+template <typename RECORD>
+inline record_list<RECORD> &_registered() {
+    static record_list<RECORD> list = {nullptr, nullptr};
+    return list;
 }
 
-inline std::vector<test_suite> &_test_suites() {
-    static std::vector<test_suite> store;
-    return store;
+template <typename RECORD>
+inline int _register(RECORD &record) {
+    auto &list = _registered<RECORD>();
+
+    (list.last ? list.last->next : list.first) = &record;
+    list.last = &record;
+
+    return 0;
 }
 
 } // namespace comp_test
 
 } // namespace dhagedorn
-
-namespace std {
-template <>
-struct hash<dhagedorn::comp_test::test_suite> {
-    std::size_t
-    operator()(dhagedorn::comp_test::test_suite const &suite) const {
-        return std::hash<std::string>{}(suite.file
-                                        + std::to_string(suite.line));
-    }
-};
-} // namespace std
\ No newline at end of file
@@ -0,0 +1,351 @@
+#pragma once
+
+/**
+ * Reading registered cases back - serialization to and from the info
+ * binary's output, and the suite each case is in
+ *
+ * Used by the info binary and the runner only.  Test sources include just
+ * comp_test.hh, so none of this is parsed in their compiles.
+ */
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "comp_test/comp_test.hh"
+
+namespace dhagedorn {
+namespace comp_test {
+
+namespace detail {
+
+class putter {
+public:
+    std::string str() {
+        auto as_str = buf.str();
+        auto len = as_str.size() > 0 ? as_str.size() - 1 : 0;
+
+        return as_str.substr(0, len);
+    }
+
+    template <typename T>
+    void operator()(T &&value) {
+        buf << escape(value) << ":";
+    }
+
+private:
+    std::string escape(const std::string &value) const {
+        auto escaped = value;
+
+        escaped = std::regex_replace(escaped, std::regex{":"}, R"(\:)");
+        escaped = std::regex_replace(escaped, std::regex{"\n"}, R"(\n)");
+
+        return escaped;
+    }
+
+    template <typename T>
+    const T &escape(const T &value) const {
+        return value;
+    }
+
+    std::stringstream buf;
+};
+
+struct getter {
+public:
+    getter(const std::string &value)
+        : _value{value} {}
+
+    std::string operator()() {
+        std::stringstream token;
+        char c;
+
+        while (take(c)) {
+            if (c == ':' || c == '\n') {
+                break;
+            }
+
+            if (c != '\\') {
+                token << c;
+                continue;
+            }
+
+            if (!take(c)) {
+                continue;
+            }
+
+            if (c == 'n') {
+                token << '\n';
+                continue;
+            }
+
+            token << c;
+        }
+
+        return token.str();
+    };
+
+private:
+    unsigned _i = 0;
+    std::string _value;
+
+    bool take(char &out) {
+        if (_i >= _value.size()) {
+            return false;
+        }
+
+        out = _value[_i++];
+        return true;
+    };
+};
+
+// clang-format off
+    // clang: "auto namespace_name::(anonymous class)::operator()() const"
+    // gcc: "namespace_name::<lambda()>\000"
+    // msvc: "auto __cdecl namespace_name::<lambda_676ec28c60ffff024507b007ccd4a443>::operator()(void) const"
+    // For no NS = remove "namespace_name::"
+// clang-format on
+inline std::string namespace_name(const std::string &symbol) {
+    std::regex reg{R"_(([\w\d_]+)::(\(anonymous|<lambda))_"};
+
+    std::smatch match;
+    if (std::regex_search(symbol, match, reg)) {
+        return match[1].str();
+    }
+
+    return "";
+}
+
+} // namespace detail
+
+using test_type_raw = std::underlying_type<test_type>::type;
+
+constexpr inline test_type_raw to_number(test_type value) {
+    return static_cast<test_type_raw>(value);
+}
+
+inline test_type from_number(test_type_raw value) {
+    switch (value) {
+        case to_number(test_type::MUST_STATIC_ASSERT):
+            return test_type::MUST_STATIC_ASSERT;
+        case to_number(test_type::MUST_COMPILE):
+            return test_type::MUST_COMPILE;
+        case to_number(test_type::MUST_BE_VALID):
+            return test_type::MUST_BE_VALID;
+        case to_number(test_type::MUST_BE_INVALID):
+            return test_type::MUST_BE_INVALID;
+        case to_number(test_type::COMP_SCALING):
+            return test_type::COMP_SCALING;
+        case to_number(test_type::COMP_BUDGET):
+            return test_type::COMP_BUDGET;
+        case to_number(test_type::COMP_CODE_SIZE):
+            return test_type::COMP_CODE_SIZE;
+        case to_number(test_type::MUST_VECTORIZE):
+            return test_type::MUST_VECTORIZE;
+        case to_number(test_type::MUST_INLINE):
+            return test_type::MUST_INLINE;
+        case to_number(test_type::MUST_NOT_REFERENCE):
+            return test_type::MUST_NOT_REFERENCE;
+    }
+
+    throw std::runtime_error{"invalid value for test_type"};
+}
+
+/** the macro a case of this type is declared with */
+inline std::string to_string(test_type value) {
+    switch (value) {
+        case test_type::MUST_STATIC_ASSERT:
+            return "MUST_STATIC_ASSERT";
+        case test_type::MUST_COMPILE:
+            return "MUST_COMPILE";
+        case test_type::MUST_BE_VALID:
+            return "MUST_BE_VALID";
+        case test_type::MUST_BE_INVALID:
+            return "MUST_BE_INVALID";
+        case test_type::COMP_SCALING:
+            return "COMP_SCALING";
+        case test_type::COMP_BUDGET:
+            return "COMP_BUDGET";
+        case test_type::COMP_CODE_SIZE:
+            return "COMP_CODE_SIZE";
+        case test_type::MUST_VECTORIZE:
+            return "MUST_VECTORIZE";
+        case test_type::MUST_INLINE:
+            return "MUST_INLINE";
+        case test_type::MUST_NOT_REFERENCE:
+            return "MUST_NOT_REFERENCE";
+    }
+
+    return std::to_string(to_number(value));
+}
+
+struct test_suite {
+    std::string file;
+    unsigned long line;
+    std::string symbol;
+    std::string name;
+    std::string description;
+
+    std::string to_string() const {
+        detail::putter put;
+
+        put(file);
+        put(line);
+        put(symbol);
+        put(name);
+        put(description);
+
+        return put.str();
+    }
+
+    static test_suite from_string(const std::string &value) {
+        detail::getter get{value};
+
+        try {
+            return test_suite{
+                get(),
+                std::stoul(get()),
+                get(),
+                get(),
+                get(),
+            };
+        } catch (std::exception &exception) {
+            std::cerr << exception.what() << std::endl;
+            throw exception;
+        }
+    }
+
+    bool operator==(const test_suite &rhs) const {
+        return file == rhs.file && line == rhs.line;
+    }
+};
+
+struct test_case {
+    std::string file;
+    unsigned long line;
+
+    // "namespace"
+    std::string detailed_name;
+    std::string symbol;
+    std::string object;
+    std::string verb;
+    std::string expected_assert_message;
+    test_type type;
+    // MUST_BE_VALID/MUST_BE_INVALID only - whether the expression was
+    // well-formed when the info binary was compiled
+    bool well_formed;
+    // COMP_SCALING/COMP_BUDGET/COMP_CODE_SIZE/MUST_NOT_REFERENCE only - the
+    // macro arguments after object and will, as written
+    std::string limits;
+
+    std::string to_string() const {
+        detail::putter put;
+
+        put(file);
+        put(line);
+        put(detailed_name);
+        put(symbol);
+        put(object);
+        put(verb);
+        put(expected_assert_message);
+        put(to_number(type));
+        put(well_formed);
+        put(limits);
+
+        return put.str();
+    }
+
+    /** whether the result was decided in the info binary, with no compile */
+    bool decided() const {
+        return type == test_type::MUST_BE_VALID
+               || type == test_type::MUST_BE_INVALID;
+    }
+
+    std::string test_suite_symbol() const {
+        return detail::namespace_name(detailed_name);
+    }
+
+    static test_case from_string(const std::string &value) {
+        detail::getter get{value};
+
+        try {
+            return test_case{
+                get(),
+                std::stoul(get()),
+                get(),
+                get(),
+                get(),
+                get(),
+                get(),
+                from_number(std::stoul(get())),
+                get() == "1",
+                get(),
+            };
+        } catch (std::exception &exception) {
+            std::cerr << exception.what() << std::endl;
+            throw exception;
+        }
+    }
+};
+
+/** every registered test case, in registration order */
+inline std::vector<test_case> _test_cases() {
+    std::vector<test_case> cases;
+
+    for (auto *record = _registered<case_record>().first; record;
+         record = record->next) {
+        cases.push_back({
+            record->file,
+            record->line,
+            record->detailed_name,
+            record->symbol,
+            record->object,
+            record->verb,
+            record->expected_assert_message,
+            record->type,
+            record->well_formed,
+            record->limits,
+        });
+    }
+
+    return cases;
+}
+
+/** every registered test suite, in registration order */
+inline std::vector<test_suite> _test_suites() {
+    std::vector<test_suite> suites;
+
+    for (auto *record = _registered<suite_record>().first; record;
+         record = record->next) {
+        suites.push_back({
+            record->file,
+            record->line,
+            record->symbol,
+            record->name,
+            record->description,
+        });
+    }
+
+    return suites;
+}
+
+} // namespace comp_test
+
+} // namespace dhagedorn
+
+namespace std {
+template <>
+struct hash<dhagedorn::comp_test::test_suite> {
+    std::size_t
+    operator()(dhagedorn::comp_test::test_suite const &suite) const {
+        return std::hash<std::string>{}(suite.file
+                                        + std::to_string(suite.line));
+    }
+};
+} // namespace std
\ No newline at end of file
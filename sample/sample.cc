@@ -1,6 +1,7 @@
 
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "comp_test/comp_test.hh"
@@ -16,6 +17,37 @@ void to_string(T &&value) {
     std::to_string(value);
 }
 
+// N instantiations deep
+template <unsigned long Tag, unsigned long N>
+struct nested {
+    using type = typename nested<Tag, N - 1>::type;
+};
+
+template <unsigned long Tag>
+struct nested<Tag, 0> {
+    using type = int;
+};
+
+// N chains of nested<>, up to N deep - N^2 / 2 instantiations
+template <unsigned long N>
+struct nested_chains : nested_chains<N - 1> {
+    using type = typename nested<N, N>::type;
+};
+
+template <>
+struct nested_chains<0> {};
+
+// from + ... + to, halving the range - C++11 constexpr, and log N deep
+constexpr unsigned long series(unsigned long from, unsigned long to) {
+    return from == to ? from
+                      : series(from, (from + to) / 2)
+                            + series((from + to) / 2 + 1, to);
+}
+
+__attribute__((noinline)) int twice(int value) {
+    return value * 2;
+}
+
 // Grouping tests by suite
 TEST_SUITE("test_types", "should all pass") {
     MUST_STATIC_ASSERT(
@@ -26,6 +58,46 @@ TEST_SUITE("test_types", "should all pass") {
     MUST_COMPILE("to_string", "only works on numbers") {
         to_string(TestCase::line);
     }
+
+    // decided while building the info binary - no compile per case
+    MUST_BE_VALID("std::to_string",
+                  "accepts numbers",
+                  double,
+                  std::to_string(std::declval<T>()));
+
+    MUST_BE_INVALID("std::to_string",
+                    "rejects vectors",
+                    std::vector<int>,
+                    std::to_string(std::declval<T>()));
+
+    // compiled at each size, as TestCase::size
+    COMP_SCALING("nested", "instantiates in linear time", linear, 16, 64, 256) {
+        typename nested<0, TestCase::size>::type value = 0;
+        (void)value;
+    }
+
+    // counted, not timed - the same on every run.  Budgeted work depends on
+    // TestCase, so it's done when the case is instantiated
+    COMP_BUDGET("nested", "stays shallow", instantiations(16)) {
+        typename nested<1, 8 + TestCase::size>::type value = 0;
+        (void)value;
+    }
+
+    COMP_BUDGET("series", "is cheap to evaluate", constexpr_steps(10000)) {
+        static_assert(series(1, 100 + TestCase::size) == 5050, "wrong sum");
+    }
+
+    // bytes of code the case adds to the source's object
+    COMP_CODE_SIZE("nested", "costs no code", 64) {
+        typename nested<1, 8>::type value = 0;
+        (void)value;
+    }
+
+    // symbols the case's code, optimized, calls
+    MUST_NOT_REFERENCE("nested", "never allocates", operator new, malloc) {
+        volatile typename nested<1, 8>::type value = TestCase::line;
+        (void)value;
+    }
 }
 
 TEST_SUITE("test_types", "should all fail") {
@@ -38,6 +110,39 @@ TEST_SUITE("test_types", "should all fail") {
     MUST_COMPILE("to_string", "only works on numbers") {
         to_string(TestCase::object);
     }
+
+    MUST_BE_VALID("std::to_string",
+                  "accepts vectors",
+                  std::vector<int>,
+                  std::to_string(std::declval<T>()));
+
+    COMP_SCALING(
+        "nested_chains", "instantiate in linear time", linear, 16, 64, 256) {
+        nested_chains<TestCase::size> chains;
+        (void)chains;
+    }
+
+    COMP_BUDGET("series", "is cheap to evaluate", constexpr_steps(100)) {
+        static_assert(series(1, 1000 + TestCase::size) == 500500,
+                      "wrong sum");
+    }
+
+    COMP_CODE_SIZE("vector", "costs no code", 64) {
+        std::vector<int> values{1, 2, 3};
+        (void)values;
+    }
+
+    MUST_NOT_REFERENCE("vector", "never allocates", operator new, malloc) {
+        std::vector<int> values{1, 2, 3};
+        volatile int first = values[0];
+        (void)first;
+    }
+
+    // noinline, and the sample builds without optimization anyway
+    MUST_INLINE("twice", "is inlined") {
+        volatile int value = twice(TestCase::line);
+        (void)value;
+    }
 }
 
 TEST_SUITE("test_types", "should all error") {
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+#include "range/v3/all.hpp"
+
+#include "log.hh"
+#include "test_case_run.hh"
+#include "test_target.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace r = ranges;
+
+/**
+ * a case's name in a baseline - by what it tests rather than its symbol,
+ * which moves with the line it's on
+ */
+inline std::string baseline_key(const test_target &target,
+                                const comp_test::test_suite &suite,
+                                const comp_test::test_case &tc) {
+    return fmt::format("{}: {} - {}: {} {} {}",
+                       target.source,
+                       suite.name,
+                       suite.description,
+                       to_string(tc.type),
+                       tc.object,
+                       tc.verb);
+}
+
+/**
+ * baseline_key() of each of a suite's cases, by file and line
+ *
+ * Cases of a suite with the same type, object and will would share a key,
+ * so from the second on they're numbered in source order - and warned
+ * about, as reordering them mixes up their samples.
+ */
+inline std::map<std::pair<std::string, unsigned long>, std::string>
+baseline_keys(const test_target &target,
+              const comp_test::test_suite &suite,
+              const std::vector<comp_test::test_case> &cases) {
+    std::map<std::pair<std::string, unsigned long>, std::string> keys;
+    std::map<std::string, unsigned long> seen;
+
+    for (auto &tc : cases) {
+        auto key = baseline_key(target, suite, tc);
+
+        if (auto n = ++seen[key]; n > 1) {
+            log_warning("cases share a baseline key, numbered in source order",
+                        "key",
+                        key,
+                        "line",
+                        tc.line);
+
+            key += fmt::format(" #{}", n);
+        }
+
+        keys[{tc.file, tc.line}] = key;
+    }
+
+    return keys;
+}
+
+inline double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto mid = values.size() / 2;
+
+    return values.size() % 2 ? values[mid]
+                             : (values[mid - 1] + values[mid]) / 2;
+}
+
+/**
+ * One-sided Mann-Whitney U test - the chance of x coming out at least this
+ * much larger than y if both were drawn from the same distribution
+ *
+ * Exact for up to 20 samples a side, the normal approximation beyond.
+ * Ties count half, and are then rounded towards the null, so ties make the
+ * test conservative rather than wrong.
+ */
+inline double mann_whitney_greater(const std::vector<double> &x,
+                                   const std::vector<double> &y) {
+    auto n = x.size();
+    auto m = y.size();
+
+    if (n == 0 || m == 0) {
+        return 1;
+    }
+
+    double u = 0;
+
+    for (auto a : x) {
+        for (auto b : y) {
+            u += a > b ? 1 : a == b ? 0.5 : 0;
+        }
+    }
+
+    if (n > 20 || m > 20) {
+        auto mean = n * m / 2.0;
+        auto sd = std::sqrt(n * m * (n + m + 1) / 12.0);
+
+        return 0.5 * std::erfc((u - 0.5 - mean) / sd / std::sqrt(2.0));
+    }
+
+    // p[i][j][k] - chance that U is k, for i samples of x and j of y: the
+    // largest of them all is x's, beating every y, or y's, beating no x
+    std::vector<std::vector<std::vector<double>>> p(
+        n + 1, std::vector<std::vector<double>>(m + 1));
+
+    for (std::size_t i = 0; i <= n; i++) {
+        for (std::size_t j = 0; j <= m; j++) {
+            auto &dist = p[i][j];
+            dist.assign(i * j + 1, 0);
+
+            if (i == 0 || j == 0) {
+                dist[0] = 1;
+                continue;
+            }
+
+            for (std::size_t k = 0; k < dist.size(); k++) {
+                auto x_largest = k >= j && k - j < p[i - 1][j].size()
+                                     ? p[i - 1][j][k - j]
+                                     : 0;
+                auto y_largest = k < p[i][j - 1].size() ? p[i][j - 1][k] : 0;
+
+                dist[k] = (i * x_largest + j * y_largest) / (i + j);
+            }
+        }
+    }
+
+    auto &dist = p[n][m];
+    double tail = 0;
+
+    for (auto k = static_cast<std::size_t>(std::floor(u)); k < dist.size();
+         k++) {
+        tail += dist[k];
+    }
+
+    return std::min(tail, 1.0);
+}
+
+/**
+ * Each case's compile CPU time and peak RSS samples - written by
+ * --write-baseline, and compared against with --baseline
+ */
+class compile_baseline {
+public:
+    struct samples {
+        std::vector<double> cpu_ms;
+        std::vector<double> peak_rss_kb;
+    };
+
+    void load(const bfs::path &path) {
+        std::ifstream fin{path.native()};
+
+        if (!fin.is_open()) {
+            log_error("could not read baseline", "path", path.native());
+            return;
+        }
+
+        std::lock_guard lock{_mutex};
+
+        // <cpu ms,...>\t<peak rss kb,...>\t<key>
+        for (std::string line; std::getline(fin, line);) {
+            auto cpu_end = line.find('\t');
+            auto rss_end = line.find('\t', cpu_end + 1);
+
+            if (cpu_end == std::string::npos || rss_end == std::string::npos) {
+                continue;
+            }
+
+            auto &s = _samples[line.substr(rss_end + 1)];
+            s.cpu_ms = _parse(line.substr(0, cpu_end));
+            s.peak_rss_kb
+                = _parse(line.substr(cpu_end + 1, rss_end - cpu_end - 1));
+        }
+    }
+
+    void save(const bfs::path &path) const {
+        std::ofstream fout{path.native()};
+
+        if (!fout.is_open()) {
+            log_error("could not write baseline", "path", path.native());
+            return;
+        }
+
+        std::lock_guard lock{_mutex};
+
+        for (auto &[key, s] : _samples) {
+            fout << fmt::format("{:.1f}\t{:.0f}\t{}\n",
+                                fmt::join(s.cpu_ms, ","),
+                                fmt::join(s.peak_rss_kb, ","),
+                                key);
+        }
+    }
+
+    void record(const std::string &key,
+                const std::vector<compile_sample> &samples) {
+        std::lock_guard lock{_mutex};
+
+        auto &s = _samples[key];
+
+        for (auto &sample : samples) {
+            s.cpu_ms.push_back(sample.cpu_ms);
+            s.peak_rss_kb.push_back(static_cast<double>(sample.peak_rss_kb));
+        }
+    }
+
+    std::optional<samples> find(const std::string &key) const {
+        std::lock_guard lock{_mutex};
+
+        if (auto found = _samples.find(key); found != _samples.end()) {
+            return found->second;
+        }
+
+        return {};
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::map<std::string, samples> _samples;
+
+    static std::vector<double> _parse(const std::string &list) {
+        std::vector<double> values;
+        std::istringstream in{list};
+
+        for (std::string value; std::getline(in, value, ',');) {
+            values.push_back(std::stod(value));
+        }
+
+        return values;
+    }
+};
+
+/** one measure of a case, before and after */
+struct baseline_change {
+    std::string measure;
+    double before;
+    double after;
+    // of a change at least this large in this direction, by chance
+    double p;
+    bool regressed;
+    bool improved;
+
+    std::string to_string() const {
+        return fmt::format("{} {:.0f} -> {:.0f} ({:+.1f}%, p={:.3f})",
+                           measure,
+                           before,
+                           after,
+                           (after / before - 1) * 100,
+                           p);
+    }
+};
+
+/**
+ * Compares cases' samples against a baseline, and totals the change over
+ * the whole run
+ *
+ * A measure has regressed when its median grew past the threshold and the
+ * samples say it's no accident - that needs a few repeats a side: 4 each at
+ * the very least, 6 or more to catch anything short of every sample moving.
+ */
+class baseline_comparison {
+public:
+    // the chance of noise alone passing for a change
+    constexpr static double significance = 0.05;
+
+    /** threshold: fraction a median must move by, ex 0.1 for 10% */
+    baseline_comparison(const bfs::path &baseline, double threshold)
+        : _threshold{threshold} {
+        _before.load(baseline);
+    }
+
+    std::vector<baseline_change>
+    compare(const std::string &key,
+            const std::vector<compile_sample> &samples) {
+        auto before = _before.find(key);
+
+        std::lock_guard lock{_mutex};
+
+        if (!before) {
+            _new++;
+            return {};
+        }
+
+        compile_baseline::samples after;
+
+        for (auto &sample : samples) {
+            after.cpu_ms.push_back(sample.cpu_ms);
+            after.peak_rss_kb.push_back(
+                static_cast<double>(sample.peak_rss_kb));
+        }
+
+        auto changes = std::vector{
+            _change("cpu ms", before->cpu_ms, after.cpu_ms),
+            _change("peak rss kb", before->peak_rss_kb, after.peak_rss_kb),
+        };
+
+        _compared++;
+        _cpu_before += changes[0].before;
+        _cpu_after += changes[0].after;
+
+        _regressed += r::any_of(changes, &baseline_change::regressed);
+        _improved += r::any_of(changes, &baseline_change::improved);
+
+        return changes;
+    }
+
+    /** the whole run's compile CPU time against the baseline's */
+    void log_summary() const {
+        std::lock_guard lock{_mutex};
+
+        log("compile time against baseline",
+            "cases compared",
+            _compared,
+            "cpu ms",
+            fmt::format("{:.0f} -> {:.0f}", _cpu_before, _cpu_after),
+            "change",
+            fmt::format("{:+.1f}%",
+                        _cpu_before > 0 ? (_cpu_after / _cpu_before - 1) * 100
+                                        : 0),
+            "regressed",
+            _regressed,
+            "improved",
+            _improved,
+            "not in baseline",
+            _new);
+    }
+
+private:
+    compile_baseline _before;
+    double _threshold;
+
+    mutable std::mutex _mutex;
+    std::size_t _compared = 0;
+    std::size_t _regressed = 0;
+    std::size_t _improved = 0;
+    std::size_t _new = 0;
+    double _cpu_before = 0;
+    double _cpu_after = 0;
+
+    baseline_change _change(const std::string &measure,
+                            const std::vector<double> &before,
+                            const std::vector<double> &after) const {
+        auto change = baseline_change{measure, median(before), median(after)};
+
+        // nothing measured to compare against
+        if (change.before <= 0) {
+            change.p = 1;
+            return change;
+        }
+
+        auto grew = change.after > change.before * (1 + _threshold);
+        auto shrank = change.after < change.before * (1 - _threshold);
+
+        change.p = grew     ? mann_whitney_greater(after, before)
+                   : shrank ? mann_whitney_greater(before, after)
+                            : 1;
+        change.regressed = grew && change.p < significance;
+        change.improved = shrank && change.p < significance;
+
+        return change;
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
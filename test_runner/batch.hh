@@ -0,0 +1,189 @@
+#pragma once
+
+#include <optional>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "comp_test/comp_test_info.hh"
+#include "compiler.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/**
+ * TestCase type for the i'th case of a batch - named in the compiler's
+ * instantiation context for every diagnostic that case causes
+ */
+inline std::string batch_instantiation(std::size_t i) {
+    return fmt::format("TestCaseInstantiation_{}", i);
+}
+
+/** which case of a batch each static_assert in its output came from */
+struct batch_attribution {
+    // per case - indices into the output of its static_asserts and their
+    // instantiation context
+    std::vector<std::vector<std::size_t>> lines;
+};
+
+/**
+ * Tie each static_assert in a batch's output to a case, by the
+ * batch_instantiation() named in its instantiation context
+ *
+ * clang gives the context as "in instantiation of ..." notes after the
+ * error, gcc as "In instantiation of"/"required from" lines before it -
+ * either way, up to the neighbouring error.  A static_assert whose context
+ * names no case of the batch, or more than one, is tied to none.
+ */
+inline batch_attribution
+attribute_static_asserts(const std::vector<std::string> &output,
+                         std::size_t cases) {
+    const static std::regex instantiation{R"(TestCaseInstantiation_(\d+))"};
+
+    auto context_first = false;
+    std::vector<std::size_t> errors;
+
+    for (std::size_t i = 0; i < output.size(); i++) {
+        auto &line = output[i];
+
+        if (line.find("In instantiation of") != std::string::npos
+            || line.find("required from") != std::string::npos) {
+            context_first = true;
+        }
+
+        auto diag = compiler_diagnostic::from_string(line);
+
+        if (diag && diag->sev == severity::error) {
+            errors.push_back(i);
+        }
+    }
+
+    batch_attribution attribution;
+    attribution.lines.resize(cases);
+
+    for (std::size_t e = 0; e < errors.size(); e++) {
+        auto error = errors[e];
+
+        if (!compiler_diagnostic::from_string(output[error])
+                 ->static_assert_msg) {
+            continue;
+        }
+
+        auto begin = error;
+
+        // gcc's context starts at "<file>: In instantiation of" - lines
+        // before that are the previous error's
+        if (context_first) {
+            auto floor = e > 0 ? errors[e - 1] + 1 : 0;
+
+            for (auto i = error; i > floor; i--) {
+                if (output[i - 1].find(": In ") != std::string::npos) {
+                    begin = i - 1;
+                    break;
+                }
+            }
+        }
+
+        auto end = context_first ? error + 1
+                                 : (e + 1 < errors.size() ? errors[e + 1]
+                                                          : output.size());
+
+        std::set<std::size_t> named;
+
+        for (auto i = begin; i < end; i++) {
+            auto from = output[i].cbegin();
+            std::smatch match;
+
+            while (std::regex_search(
+                from, output[i].cend(), match, instantiation)) {
+                named.insert(std::stoul(match[1]));
+                from = match[0].second;
+            }
+        }
+
+        if (named.size() != 1 || *named.begin() >= cases) {
+            continue;
+        }
+
+        auto &lines = attribution.lines[*named.begin()];
+
+        for (auto i = begin; i < end; i++) {
+            lines.push_back(i);
+        }
+    }
+
+    return attribution;
+}
+
+/**
+ * Each case's own result from a batch's compile, or nothing for cases the
+ * batch can't decide - compile those alone
+ *
+ * If the batch compiled, so did every case.  Otherwise only passes are
+ * decided: a case whose own static_asserts include the expected message
+ * passes, whatever else failed.  No other outcome can be trusted - the
+ * compiler instantiates a specialization the cases share once, so its
+ * static_assert is tied only to the first case that got there, and the
+ * rest look like they didn't assert.
+ */
+inline std::vector<std::optional<compile_result>>
+split_batch(const compile_result &batch,
+            const std::vector<comp_test::test_case> &cases) {
+    std::vector<std::optional<compile_result>> results(cases.size());
+
+    auto share = [&](std::vector<std::string> stderr) {
+        auto result = compile_result{};
+        result.input = batch.input;
+        result.compiled = batch.compiled;
+        result.compile_output.exit_code = batch.compile_output.exit_code;
+        result.compile_output.stderr = std::move(stderr);
+        result.compile_output.peak_rss_kb = batch.compile_output.peak_rss_kb;
+        result.compile_output.cpu_seconds
+            = batch.compile_output.cpu_seconds / cases.size();
+
+        for (auto &line : result.compile_output.stderr) {
+            if (auto diag = compiler_diagnostic::from_string(line)) {
+                result.diagnostics.push_back(*diag);
+            }
+        }
+
+        return result;
+    };
+
+    if (batch.compiled) {
+        for (auto &result : results) {
+            result = share(batch.compile_output.stderr);
+        }
+
+        return results;
+    }
+
+    auto &output = batch.compile_output.stderr;
+    auto attribution = attribute_static_asserts(output, cases.size());
+
+    for (std::size_t i = 0; i < cases.size(); i++) {
+        auto &lines = attribution.lines[i];
+
+        if (lines.empty()) {
+            continue;
+        }
+
+        std::vector<std::string> own;
+
+        for (auto line : lines) {
+            own.push_back(output[line]);
+        }
+
+        auto result = share(std::move(own));
+
+        if (result.has_static_assert(cases[i].expected_assert_message)) {
+            results[i] = std::move(result);
+        }
+    }
+
+    return results;
+}
+
+} // namespace dhagedorn::comp_test::impl
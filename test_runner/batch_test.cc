@@ -0,0 +1,141 @@
+// Checks splitting a batch's compile output into per-case results
+//
+// bazel test //test_runner:batch_test
+//
+// testdata/batch.cc is a batch as the runner writes it, four cases each with
+// its own TestCaseInstantiation_<i>.  Cases 0 and 1 call the same
+// to_string<double>, which the compiler instantiates - and asserts in - once,
+// for case 0 only, and case 1 also asserts some other message of its own.
+// Case 2 asserts on its own, case 3 compiles.  testdata/batch_gcc.txt is gcc
+// 12's output for it, batch_clang.txt clang's.
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "comp_test/comp_test_info.hh"
+#include "test_runner/batch.hh"
+
+namespace {
+
+namespace ct = dhagedorn::comp_test;
+namespace impl = dhagedorn::comp_test::impl;
+
+auto failures = 0;
+
+void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+std::vector<std::string> read_lines(const std::string &name) {
+    std::ifstream fin{"test_runner/testdata/" + name};
+
+    if (!fin.is_open()) {
+        throw std::runtime_error{"could not open test data " + name};
+    }
+
+    std::vector<std::string> lines;
+
+    for (std::string line; std::getline(fin, line);) {
+        lines.push_back(line);
+    }
+
+    return lines;
+}
+
+std::vector<ct::test_case> cases(const std::string &case_2_message) {
+    auto make = [](unsigned long line, std::string message) {
+        auto tc = ct::test_case{};
+        tc.file = "sample/sample.cc";
+        tc.line = line;
+        tc.expected_assert_message = std::move(message);
+        tc.type = ct::test_type::MUST_STATIC_ASSERT;
+
+        return tc;
+    };
+
+    return {make(10, "type not supported"),
+            make(15, "type not supported"),
+            make(20, case_2_message),
+            make(25, "type not supported")};
+}
+
+impl::compile_result batch(const std::vector<std::string> &output,
+                           bool compiled) {
+    auto result = impl::compile_result{};
+    result.compiled = compiled;
+    result.compile_output.exit_code = compiled ? 0 : 1;
+    result.compile_output.stderr = output;
+
+    return result;
+}
+
+void check_output(const std::string &compiler) {
+    auto output = read_lines(fmt::format("batch_{}.txt", compiler));
+    auto attribution = impl::attribute_static_asserts(output, 4);
+
+    auto asserts_in = [&](std::size_t i) {
+        std::vector<std::string> messages;
+
+        for (auto line : attribution.lines[i]) {
+            auto diag = impl::compiler_diagnostic::from_string(output[line]);
+
+            if (diag && diag->static_assert_msg) {
+                messages.push_back(*diag->static_assert_msg);
+            }
+        }
+
+        return messages;
+    };
+
+    check(asserts_in(0) == std::vector<std::string>{"type not supported"},
+          compiler + ": case 0 asserts in the shared instantiation");
+    check(asserts_in(1) == std::vector<std::string>{"unrelated"},
+          compiler + ": case 1's shared assert is named only with case 0");
+    check(asserts_in(2) == std::vector<std::string>{"own message"},
+          compiler + ": case 2 asserts on its own");
+    check(asserts_in(3).empty(), compiler + ": case 3 doesn't assert");
+
+    auto split = impl::split_batch(batch(output, false), cases("own message"));
+
+    check(split[0] && split[0]->has_static_assert("type not supported"),
+          compiler + ": case 0 passes");
+    check(!split[1], compiler + ": case 1 is compiled alone, not failed");
+    check(split[2] && split[2]->has_static_assert("own message"),
+          compiler + ": case 2 passes");
+    check(!split[3], compiler + ": case 3 is compiled alone");
+
+    split = impl::split_batch(batch(output, false), cases("other message"));
+
+    check(!split[2],
+          compiler + ": case 2 asserting the wrong message is compiled alone");
+}
+
+void check_compiled() {
+    auto split = impl::split_batch(batch({}, true), cases("own message"));
+
+    for (std::size_t i = 0; i < split.size(); i++) {
+        check(split[i] && split[i]->compiled,
+              fmt::format("case {} compiled with the batch", i));
+    }
+}
+
+} // namespace
+
+int main() {
+    check_output("gcc");
+    check_output("clang");
+    check_compiled();
+
+    if (failures > 0) {
+        std::cerr << failures << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all passed" << std::endl;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+
+#include "time_trace.hh"
+#include "util.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** a COMP_BUDGET case's limits, from its macro arguments */
+struct budget_spec {
+    std::optional<unsigned long> instantiations;
+    std::optional<unsigned long> constexpr_steps;
+
+    /**
+     * "instantiations(<n>)" and/or "constexpr_steps(<n>)", comma separated
+     * - empty if it doesn't parse
+     */
+    static std::optional<budget_spec> parse(const std::string &args) {
+        const static std::regex item{
+            R"(^\s*(\w+)\s*\(\s*([0-9']+)[uUlL]*\s*\)\s*(,|$))"};
+
+        budget_spec spec;
+        auto rest = args;
+        std::smatch match;
+
+        while (std::regex_search(rest, match, item)) {
+            auto name = match[1].str();
+            auto value = parse_count(match[2].str());
+
+            if (!value) {
+                return {};
+            } else if (name == "instantiations" && !spec.instantiations) {
+                spec.instantiations = value;
+            } else if (name == "constexpr_steps" && !spec.constexpr_steps) {
+                spec.constexpr_steps = value;
+            } else {
+                return {};
+            }
+
+            rest = match.suffix();
+        }
+
+        if (rest.find_first_not_of(" \t\n") != std::string::npos
+            || (!spec.instantiations && !spec.constexpr_steps)) {
+            return {};
+        }
+
+        return spec;
+    }
+};
+
+/**
+ * Template instantiations in a clang -ftime-trace - every one, if it was
+ * written with -ftime-trace-granularity=0
+ */
+inline unsigned long count_instantiations(const bfs::path &trace) {
+    unsigned long count = 0;
+
+    for (auto &event : read_time_trace(trace)) {
+        count += event.name == "InstantiateClass"
+                 || event.name == "InstantiateFunction";
+    }
+
+    return count;
+}
+
+/** what a COMP_BUDGET case measured, against its limits */
+struct budget_result {
+    budget_spec spec;
+    // instantiations the case added to those of the source alone
+    std::optional<unsigned long> instantiations;
+    // the least -fconstexpr-steps the case compiles with, to within 1% -
+    // empty if it needs more than its budget
+    std::optional<unsigned long> constexpr_steps;
+    // the same for the source with no case - the case's own evaluations
+    // can't be told apart below it
+    std::optional<unsigned long> source_constexpr_steps;
+    // why a budgeted count couldn't be measured
+    std::optional<std::string> unmeasured;
+
+    bool within_budget() const {
+        return !unmeasured
+               && (!spec.instantiations
+                   || (instantiations
+                       && *instantiations <= *spec.instantiations))
+               && (!spec.constexpr_steps || constexpr_steps);
+    }
+
+    std::string to_string() const {
+        std::vector<std::string> counts;
+
+        if (spec.instantiations) {
+            counts.push_back(fmt::format("{} instantiations, of {}",
+                                         instantiations
+                                             ? std::to_string(*instantiations)
+                                             : "unknown",
+                                         *spec.instantiations));
+        }
+
+        if (spec.constexpr_steps) {
+            auto within_source = constexpr_steps && source_constexpr_steps
+                                 && *constexpr_steps <= *source_constexpr_steps;
+
+            counts.push_back(fmt::format(
+                "{}{} constexpr steps{}, of {}",
+                within_source ? "at most " : "",
+                constexpr_steps ? std::to_string(*constexpr_steps)
+                                : "over budget",
+                within_source ? ", the source's own" : "",
+                *spec.constexpr_steps));
+        }
+
+        return fmt::format("{}", fmt::join(counts, ", "));
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
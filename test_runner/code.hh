@@ -3,6 +3,8 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "fmt/core.h"
 
@@ -12,8 +14,46 @@ namespace dhagedorn::comp_test::impl {
 
 namespace bfs = boost::filesystem;
 
+/**
+ * a #line directive naming path, for a copy of it written elsewhere - so
+ * __FILE__, and so TestCase::file, and diagnostics name the source, not the
+ * copy
+ */
+inline std::string line_marker(const std::string &path) {
+    std::string escaped;
+
+    for (auto c : path) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+        }
+
+        escaped += c;
+    }
+
+    return fmt::format("#line 1 \"{}\"\n", escaped);
+}
+
+/**
+ * compiler args for a copy of source written elsewhere - source's own
+ * directory is searched first for "quoted" includes, as it would be for
+ * source itself
+ */
+inline std::vector<std::string>
+copy_args(const std::string &source, const std::vector<std::string> &args) {
+    std::vector<std::string> with_dir = {
+        "-iquote", bfs::absolute(source).parent_path().native()};
+
+    with_dir.insert(with_dir.end(), args.begin(), args.end());
+
+    return with_dir;
+}
+
 class code {
 public:
+    /** no code yet - append() to it */
+    code() = default;
+
+    /** the source at path, marked with a line_marker() */
     code(std::string path)
         : _path{path}
         , _content{read_file()} {}
@@ -47,7 +87,7 @@ private:
         }
 
         std::stringstream str;
-        str << fin.rdbuf();
+        str << line_marker(_path) << fin.rdbuf();
 
         return str;
     }
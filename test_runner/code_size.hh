@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+
+#include "elf.hh"
+#include "util.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** a COMP_CODE_SIZE case's budget, from its macro arguments */
+struct code_size_spec {
+    unsigned long text_bytes;
+
+    /** "<bytes>" - empty if it doesn't parse */
+    static std::optional<code_size_spec> parse(const std::string &args) {
+        auto bytes = parse_count(args);
+
+        if (!bytes) {
+            return {};
+        }
+
+        return code_size_spec{*bytes};
+    }
+};
+
+/** what a COMP_CODE_SIZE case emitted, against its budget */
+struct code_size_result {
+    code_size_spec spec;
+    // executable bytes the case added to those of the source alone
+    std::optional<unsigned long> text_bytes;
+    // functions the case added or resized, largest first
+    std::vector<elf_function> functions;
+    // why the object couldn't be read
+    std::optional<std::string> unmeasured;
+
+    // functions listed in the failure message
+    constexpr static std::size_t listed = 10;
+
+    /** the case's object against one of the source alone */
+    static code_size_result of(const code_size_spec &spec,
+                               const elf_object &with_case,
+                               const elf_object &alone) {
+        auto result = code_size_result{spec};
+
+        result.text_bytes = with_case.text_bytes > alone.text_bytes
+                                ? with_case.text_bytes - alone.text_bytes
+                                : 0;
+
+        std::map<std::string, unsigned long> before;
+
+        for (auto &function : alone.functions) {
+            before[function.name] = function.bytes;
+        }
+
+        for (auto &function : with_case.functions) {
+            auto found = before.find(function.name);
+
+            if (found == before.end() || found->second != function.bytes) {
+                result.functions.push_back(
+                    {demangle(function.name), function.bytes});
+            }
+        }
+
+        std::stable_sort(result.functions.begin(),
+                         result.functions.end(),
+                         [](auto &l, auto &r) { return l.bytes > r.bytes; });
+
+        return result;
+    }
+
+    bool within_budget() const {
+        return !unmeasured && text_bytes && *text_bytes <= spec.text_bytes;
+    }
+
+    std::string to_string() const {
+        std::vector<std::string> sizes;
+
+        for (std::size_t i = 0; i < functions.size() && i < listed; i++) {
+            sizes.push_back(
+                fmt::format("{}: {}", functions[i].name, functions[i].bytes));
+        }
+
+        if (functions.size() > listed) {
+            sizes.push_back(
+                fmt::format("{} more", functions.size() - listed));
+        }
+
+        return fmt::format("{} bytes of .text, of {} - {}",
+                           text_bytes ? std::to_string(*text_bytes)
+                                      : "unknown",
+                           spec.text_bytes,
+                           sizes.empty() ? "no functions added"
+                                         : fmt::format("{}",
+                                                       fmt::join(sizes, ", ")));
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <fnmatch.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "boost/program_options/parsers.hpp"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+
+#include "log.hh"
+#include "test_target.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace pt = boost::property_tree;
+
+/**
+ * Targets for every compile_commands.json entry whose file matches one of
+ * patterns
+ *
+ * patterns are fnmatch(3) globs, matched against both the absolute path of
+ * the entry's file and its path relative to the directory holding
+ * compile_commands.json - so a glob like `tests/<name>_comp_test.cc` works
+ * from a repo root
+ */
+inline std::vector<test_target>
+read_compdb(const bfs::path &path, const std::vector<std::string> &patterns) {
+    pt::ptree root;
+
+    try {
+        pt::read_json(path.native(), root);
+    } catch (pt::json_parser_error &err) {
+        log_error("could not read compilation database",
+                  "path",
+                  path.native(),
+                  "error",
+                  err.what());
+        return {};
+    }
+
+    auto root_dir = bfs::absolute(path).parent_path();
+
+    auto matches = [&](const bfs::path &file) {
+        auto relative = file.lexically_relative(root_dir);
+
+        for (auto &pattern : patterns) {
+            if (fnmatch(pattern.c_str(), file.c_str(), 0) == 0
+                || fnmatch(pattern.c_str(), relative.c_str(), 0) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    std::vector<test_target> targets;
+
+    for (auto &[_, entry] : root) {
+        auto directory = bfs::path{entry.get<std::string>("directory", "")};
+        auto file = bfs::path{entry.get<std::string>("file", "")};
+
+        if (file.is_relative()) {
+            file = (directory / file).lexically_normal();
+        }
+
+        if (!matches(file)) {
+            continue;
+        }
+
+        std::vector<std::string> command;
+
+        if (auto arguments = entry.get_child_optional("arguments")) {
+            for (auto &[_, arg] : *arguments) {
+                command.push_back(arg.get_value<std::string>());
+            }
+        } else {
+            command = boost::program_options::split_unix(
+                entry.get<std::string>("command", ""));
+        }
+
+        if (command.empty()) {
+            log_warning("no command for entry", "file", file.native());
+            continue;
+        }
+
+        targets.push_back({
+            file.native(),
+            command.front(),
+            {command.begin() + 1, command.end()},
+            {},
+            directory,
+        });
+    }
+
+    return targets;
+}
+
+} // namespace dhagedorn::comp_test::impl
@@ -1,18 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <regex>
+#include <set>
 #include <string>
 #include <unordered_map>
 
 #include "boost/filesystem.hpp"
 #include "boost/optional.hpp"
 #include "fmt/format.h"
+#include "fmt/ranges.h"
 #include "range/v3/all.hpp"
 
 #include "executable.hh"
+#include "frontend.hh"
+#include "jobserver.hh"
 #include "log.hh"
+#include "spill.hh"
+#include "trace.hh"
 
 namespace dhagedorn::comp_test::impl {
 
@@ -22,6 +34,8 @@ namespace rv = ranges::views;
 
 enum class severity {
     info,
+    // optimization remarks - clang's -Rpass, gcc's -fopt-info
+    remark,
     warning,
     error,
     unknown,
@@ -40,6 +54,9 @@ struct compiler_diagnostic {
     inline const static std::unordered_map<std::string, severity>
         severity_words{
             {"note", severity::info},
+            {"remark", severity::remark},
+            {"optimized", severity::remark},
+            {"missed", severity::remark},
             {"warning", severity::warning},
             {"error", severity::error},
         };
@@ -102,6 +119,12 @@ struct compile_result {
     executable_output compile_output;
     std::vector<compiler_diagnostic> diagnostics;
     bool compiled;
+    // clang's -ftime-trace output, if it was asked for
+    std::optional<bfs::path> time_trace;
+    // compile_output moved to disk, if it was too big to keep in memory
+    std::shared_ptr<const spilled_output> spilled;
+    // compiled against the source's precompiled header
+    bool pch = false;
 
     bool has_static_assert(const std::string &msg) const {
         return r::any_of(diagnostics, [&](auto &diag) {
@@ -130,22 +153,104 @@ struct compile_result {
 
 class compiler {
 public:
-    compiler(std::string path, std::vector<std::string> args)
+    /**
+     * time_trace: also have clang write its -ftime-trace JSON next to the
+     * output - ignored, with a warning, for other compilers
+     * cwd: directory to compile in, for args relative to it - ex, a
+     * compile_commands.json entry's "directory"
+     * direct_frontend: run the driver's frontend job (clang -cc1) itself,
+     * resolved once per run for these args - see frontend_command
+     */
+    compiler(std::string path,
+             std::vector<std::string> args,
+             bool time_trace = false,
+             bfs::path cwd = {},
+             bool direct_frontend = false)
         : _path{path}
-        , _args{args} {}
+        , _args{args}
+        , _time_trace{time_trace}
+        , _cwd{cwd}
+        , _direct_frontend{direct_frontend} {
+        // gcc rejects -ftime-trace, so every case would fail to compile
+        if (_time_trace && !is_clang()) {
+            _time_trace = false;
+
+            std::lock_guard lock{_frontends_mutex};
+
+            if (_untraced.insert(_path).second) {
+                log_warning("time traces are clang only - skipped for this "
+                            "compiler",
+                            "compiler",
+                            _path);
+            }
+        }
+    }
+
+    /** compiler processes started by every compiler in this run */
+    static unsigned long invocations() { return _invocations; }
+
+    /** whether --version says clang - asked once per compiler */
+    bool is_clang() const {
+        std::lock_guard lock{_frontends_mutex};
+
+        if (auto found = _clang.find(_path); found != _clang.end()) {
+            return found->second;
+        }
+
+        auto output = executable{_path, {"--version"}, _cwd}.run();
+
+        return _clang[_path] = r::any_of(output.stdout, [](auto &line) {
+                   return line.find("clang") != std::string::npos;
+               });
+    }
+
+    /**
+     * output: where to write the object, a temp file by default
+     * on_start: called with the compiler's pid once it has started
+     */
+    compile_result compile(bfs::path input,
+                           std::optional<bfs::path> output = {},
+                           std::function<void(int)> on_start = {}) {
+        auto span = trace_span{"compile", "runner"};
+
+        _invocations++;
 
-    compile_result compile(bfs::path input) {
-        auto output = bfs::temp_directory_path()
-                      / bfs::unique_path().replace_extension(".o");
+        if (!output) {
+            output = bfs::temp_directory_path()
+                     / bfs::unique_path().replace_extension(".o");
+        }
+
+        auto frontend = _direct_frontend ? _frontend() : nullptr;
 
-        executable exec{_path, _rewrite_args(_args, input, output)};
+        auto exec = frontend ? executable{frontend->program(),
+                                          frontend->args(input, *output),
+                                          _cwd,
+                                          on_start}
+                             : executable{_path,
+                                          rewrite_args(_args, input, *output),
+                                          _cwd,
+                                          on_start};
 
         compile_result comp_result;
 
-        comp_result.compile_output = exec.run();
+        auto token = [] {
+            auto span = trace_span{"jobserver token", "runner"};
+            return jobserver::instance().acquire();
+        }();
+
+        auto process_start = tracer::clock::now();
+
+        {
+            auto span = trace_span{"compiler process", "runner"};
+            comp_result.compile_output = exec.run();
+            // parsing the output needs no slot - let another compile start
+            auto released = std::move(token);
+        }
+
+        auto parse_span = trace_span{"parse output", "runner"};
 
-        if (bfs::is_regular(output)) {
-            bfs::permissions(output,
+        if (bfs::is_regular(*output)) {
+            bfs::permissions(*output,
                              bfs::perms::owner_exe | bfs::perms::owner_read
                                  | bfs::perms::owner_write);
         }
@@ -161,27 +266,39 @@ public:
               | rv::transform([](const auto &diag) { return *diag; })
               | r::to<std::vector>();
 
-        comp_result.exec = executable{output, {}};
+        comp_result.exec = executable{*output, {}};
 
         if (comp_result.compile_output.exit_code == 0) {
-            comp_result.binary = output;
+            comp_result.binary = *output;
             comp_result.compiled = true;
         } else {
             comp_result.compiled = false;
         }
 
+        if (_time_trace) {
+            auto trace = bfs::path{*output}.replace_extension(".json");
+
+            if (bfs::is_regular(trace)) {
+                comp_result.time_trace = trace;
+                tracer::instance().merge_time_trace(trace, process_start);
+            }
+        }
+
         return comp_result;
     }
 
-private:
-    std::vector<std::string> _rewrite_args(const std::vector<std::string> &args,
-                                           const bfs::path &input,
-                                           const bfs::path &output) {
+    /**
+     * args, with the source file and output replaced by input and output, and
+     * the flags the runner needs added
+     */
+    std::vector<std::string> rewrite_args(const std::vector<std::string> &args,
+                                          const bfs::path &input,
+                                          const bfs::path &output) const {
         auto rewritten = args;
         //= _args | rv::remove_if([](const auto &e) { return e == "-c"; })
         //  | r::to<std::vector>();
 
-        std::regex is_cc{R"(.*\.(c|cc|cpp))"};
+        std::regex is_cc{R"(.*\.(c|cc|cpp|cxx))"};
 
         bool wrote_input = false;
         bool wrote_output = false;
@@ -217,13 +334,107 @@ private:
 
         // Should work for clang and gcc
         rewritten.push_back("-fdiagnostics-color=never");
-        // log("rewritten args", "rewritten", rewritten);
+
+        if (_time_trace) {
+            // clang only, see the constructor - written to <output>.json
+            rewritten.push_back("-ftime-trace");
+        }
+
+        log_trace("rewritten args", "rewritten", rewritten);
 
         return rewritten;
     }
 
+    /**
+     * args for linking object into output - the compile's flags, such as
+     * -stdlib, --target or -fsanitize, less its inputs, -c, -o, -x and
+     * dependency file flags
+     */
+    std::vector<std::string> link_args(const bfs::path &object,
+                                       const bfs::path &output) const {
+        std::regex is_cc{R"(.*\.(c|cc|cpp|cxx))"};
+
+        std::vector<std::string> linking;
+
+        for (std::size_t i = 0; i < _args.size(); i++) {
+            auto &arg = _args[i];
+
+            if (arg == "-o" || arg == "-x" || arg == "-MF" || arg == "-MT"
+                || arg == "-MQ") {
+                i++;
+            } else if (arg != "-c" && arg != "-MD" && arg != "-MMD"
+                       && !std::regex_match(arg, is_cc)) {
+                linking.push_back(arg);
+            }
+        }
+
+        linking.push_back("-o");
+        linking.push_back(output.native());
+        linking.push_back(object.native());
+
+        return linking;
+    }
+
+private:
+    inline static std::atomic<unsigned long> _invocations = 0;
+
+    // per driver, args and cwd - null where there's no single frontend job.
+    // Also guards _clang and _untraced
+    inline static std::mutex _frontends_mutex;
+    inline static std::map<std::string,
+                           std::shared_ptr<const frontend_command>>
+        _frontends;
+    inline static std::map<std::string, bool> _clang;
+    // compilers warned about skipping time traces for
+    inline static std::set<std::string> _untraced;
+
     std::string _path;
     std::vector<std::string> _args;
+    bool _time_trace;
+    bfs::path _cwd;
+    bool _direct_frontend;
+
+    std::shared_ptr<const frontend_command> _frontend() const {
+        auto key = fmt::format("{}\n{}\n{}\n{}",
+                               _path,
+                               _cwd.native(),
+                               _time_trace,
+                               fmt::join(_args, "\n"));
+
+        std::lock_guard lock{_frontends_mutex};
+
+        if (auto found = _frontends.find(key); found != _frontends.end()) {
+            return found->second;
+        }
+
+        auto span = trace_span{"resolve frontend", "runner"};
+
+        _invocations++;
+
+        // the driver checks its input exists
+        auto placeholder = bfs::temp_directory_path() / bfs::unique_path();
+        auto input = bfs::path{placeholder.native() + "-input.cc"};
+        auto output = bfs::path{placeholder.native() + "-output.o"};
+
+        std::ofstream{input.native()};
+
+        auto resolved = frontend_command::resolve(
+            _path, rewrite_args(_args, input, output), input, output, _cwd);
+
+        bfs::remove(input);
+
+        if (!resolved) {
+            log_warning("could not resolve the compiler's frontend command - "
+                        "compiling through the driver",
+                        "compiler",
+                        _path);
+        }
+
+        return _frontends[key]
+               = resolved ? std::make_shared<const frontend_command>(
+                     std::move(*resolved))
+                          : nullptr;
+    }
 };
 
 } // namespace dhagedorn::comp_test::impl
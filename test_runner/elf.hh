@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cxxabi.h>
+#include <elf.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/** name demangled, or as it is if it isn't a C++ name */
+inline std::string demangle(const std::string &name) {
+    int status = 0;
+    auto demangled
+        = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+
+    if (status != 0 || !demangled) {
+        return name;
+    }
+
+    std::string readable{demangled};
+    std::free(demangled);
+
+    return readable;
+}
+
+/** a function defined in an object, by its mangled name */
+struct elf_function {
+    std::string name;
+    unsigned long bytes;
+};
+
+/**
+ * The code in a relocatable ELF object, from its section headers, symbol
+ * table and relocations - read directly, so nothing like readelf or nm needs
+ * to be installed
+ */
+struct elf_object {
+    // every executable section: .text, and the .text.<name> sections of
+    // inline functions and templates, in COMDAT groups
+    unsigned long text_bytes = 0;
+    std::vector<elf_function> functions;
+    // relocations in code against each symbol, by mangled name - a call to
+    // a function in another object, or to one that could be replaced, ex
+    std::map<std::string, unsigned long> references;
+
+    /**
+     * empty if path isn't a relocatable ELF object in this machine's byte
+     * order - ex an LLVM bitcode file, from -flto
+     */
+    static std::optional<elf_object> read(const bfs::path &path) {
+        bfs::ifstream fin{path, std::ios::binary};
+        std::vector<char> bytes{std::istreambuf_iterator<char>{fin}, {}};
+
+        if (bytes.size() < EI_NIDENT
+            || std::memcmp(bytes.data(), ELFMAG, SELFMAG) != 0
+            || bytes[EI_DATA] != _host_data()) {
+            return {};
+        }
+
+        switch (bytes[EI_CLASS]) {
+            case ELFCLASS32:
+                return _read<Elf32_Ehdr,
+                             Elf32_Shdr,
+                             Elf32_Sym,
+                             Elf32_Rel,
+                             Elf32_Rela>(bytes);
+            case ELFCLASS64:
+                return _read<Elf64_Ehdr,
+                             Elf64_Shdr,
+                             Elf64_Sym,
+                             Elf64_Rel,
+                             Elf64_Rela>(bytes);
+        }
+
+        return {};
+    }
+
+private:
+    static char _host_data() {
+        const std::uint16_t one = 1;
+
+        return *reinterpret_cast<const char *>(&one) == 1 ? ELFDATA2LSB
+                                                           : ELFDATA2MSB;
+    }
+
+    /** a T at offset, copied - nothing in the file need be aligned */
+    template <typename T>
+    static std::optional<T> _at(const std::vector<char> &bytes,
+                                std::uint64_t offset) {
+        if (offset > bytes.size() || bytes.size() - offset < sizeof(T)) {
+            return {};
+        }
+
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+
+        return value;
+    }
+
+    static std::uint64_t _symbol_index(Elf32_Word info) {
+        return ELF32_R_SYM(info);
+    }
+
+    static std::uint64_t _symbol_index(Elf64_Xword info) {
+        return ELF64_R_SYM(info);
+    }
+
+    template <typename Ehdr,
+              typename Shdr,
+              typename Sym,
+              typename Rel,
+              typename Rela>
+    static std::optional<elf_object> _read(const std::vector<char> &bytes) {
+        auto header = _at<Ehdr>(bytes, 0);
+
+        if (!header || header->e_type != ET_REL
+            || header->e_shentsize != sizeof(Shdr)) {
+            return {};
+        }
+
+        // past 0xff00 sections, the count is in the first section's size
+        std::uint64_t count = header->e_shnum;
+
+        if (count == 0 && header->e_shoff != 0) {
+            auto first = _at<Shdr>(bytes, header->e_shoff);
+            count = first ? first->sh_size : 0;
+        }
+
+        std::vector<Shdr> sections;
+
+        for (std::uint64_t i = 0; i < count; i++) {
+            auto section = _at<Shdr>(bytes, header->e_shoff + i * sizeof(Shdr));
+
+            if (!section) {
+                return {};
+            }
+
+            sections.push_back(*section);
+        }
+
+        elf_object object;
+
+        // names of each symbol table's symbols, by the table's section
+        std::map<std::uint64_t, std::vector<std::string>> symbol_names;
+
+        for (std::uint64_t i = 0; i < sections.size(); i++) {
+            auto &section = sections[i];
+
+            if (section.sh_type == SHT_PROGBITS
+                && (section.sh_flags & SHF_EXECINSTR)) {
+                object.text_bytes += section.sh_size;
+            }
+
+            if (section.sh_type != SHT_SYMTAB
+                || section.sh_link >= sections.size()) {
+                continue;
+            }
+
+            auto &names = sections[section.sh_link];
+
+            if (names.sh_offset > bytes.size()
+                || bytes.size() - names.sh_offset < names.sh_size) {
+                return {};
+            }
+
+            auto &table = symbol_names[i];
+
+            // aliases - ex a complete and a base object constructor that
+            // compiled the same - are one function
+            std::set<std::pair<std::uint64_t, std::uint64_t>> addresses;
+
+            for (std::uint64_t offset = 0;
+                 offset + sizeof(Sym) <= section.sh_size;
+                 offset += sizeof(Sym)) {
+                auto symbol = _at<Sym>(bytes, section.sh_offset + offset);
+
+                if (!symbol) {
+                    return {};
+                }
+
+                table.emplace_back();
+
+                if (symbol->st_name < names.sh_size) {
+                    auto name = bytes.data() + names.sh_offset;
+                    auto end = name + names.sh_size;
+
+                    table.back().assign(name + symbol->st_name,
+                                        std::find(name + symbol->st_name,
+                                                  end,
+                                                  '\0'));
+                }
+
+                // ELF32_ST_TYPE is the same
+                if (ELF64_ST_TYPE(symbol->st_info) != STT_FUNC
+                    || symbol->st_shndx == SHN_UNDEF || symbol->st_size == 0
+                    || table.back().empty()
+                    || !addresses.emplace(symbol->st_shndx, symbol->st_value)
+                            .second) {
+                    continue;
+                }
+
+                object.functions.push_back(
+                    {table.back(),
+                     static_cast<unsigned long>(symbol->st_size)});
+            }
+        }
+
+        for (auto &section : sections) {
+            auto read = true;
+
+            if (section.sh_type == SHT_RELA) {
+                read = _count_references<Rela>(
+                    bytes, sections, section, symbol_names, object);
+            } else if (section.sh_type == SHT_REL) {
+                read = _count_references<Rel>(
+                    bytes, sections, section, symbol_names, object);
+            }
+
+            if (!read) {
+                return {};
+            }
+        }
+
+        return object;
+    }
+
+    /**
+     * count the symbols a relocation section refers to from code - false if
+     * it runs past the end of the file
+     */
+    template <typename Entry, typename Shdr>
+    static bool _count_references(
+        const std::vector<char> &bytes,
+        const std::vector<Shdr> &sections,
+        const Shdr &section,
+        const std::map<std::uint64_t, std::vector<std::string>> &symbol_names,
+        elf_object &object) {
+        auto names = symbol_names.find(section.sh_link);
+
+        if (section.sh_info >= sections.size()
+            || !(sections[section.sh_info].sh_flags & SHF_EXECINSTR)
+            || names == symbol_names.end()) {
+            return true;
+        }
+
+        for (std::uint64_t offset = 0;
+             offset + sizeof(Entry) <= section.sh_size;
+             offset += sizeof(Entry)) {
+            auto entry = _at<Entry>(bytes, section.sh_offset + offset);
+
+            if (!entry) {
+                return false;
+            }
+
+            auto index = _symbol_index(entry->r_info);
+
+            // section symbols, for code's references to its own object's
+            // data, have no name
+            if (index < names->second.size()
+                && !names->second[index].empty()) {
+                object.references[names->second[index]]++;
+            }
+        }
+
+        return true;
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <functional>
 #include <future>
 #include <regex>
 #include <string>
@@ -22,19 +28,31 @@ struct executable_output {
     int exit_code;
     std::vector<std::string> stdout;
     std::vector<std::string> stderr;
+    // peak RSS of the process and the children it waited for (cc1plus, etc.)
+    long peak_rss_kb = 0;
+    // user + system CPU time of the same
+    double cpu_seconds = 0;
 };
 
 struct executable {
     bfs::path path;
     std::vector<std::string> args;
+    // working directory to run in - the runner's own if empty
+    bfs::path cwd = {};
+    // called with the pid once the process has started
+    std::function<void(int)> on_start = {};
 
     auto run() const {
-        std::vector<std::string> prefix = {path.native()};
+        if (log_enabled<log_level::trace>()) {
+            std::vector<std::string> prefix = {path.native()};
+
+            auto cmd_line = ranges::views::concat(prefix, args)
+                            | ranges::views::join(' ')
+                            | ranges::to<std::string>();
 
-        auto cmd_line = ranges::views::concat(prefix, args)
-                        | ranges::views::join(' ') | ranges::to<std::string>();
+            log_trace("cmd line", "line", cmd_line);
+        }
 
-        // log("cmd line", "line", cmd_line);
         executable_output out;
 
         boost::asio::io_service ios;
@@ -44,19 +62,46 @@ struct executable {
         try {
             proc = bp::child(path,
                              bp::args(args),
+                             bp::start_dir(cwd.empty() ? bfs::current_path()
+                                                       : cwd),
                              bp::std_err > stderr,
                              bp::std_out > stdout,
                              ios);
 
+            if (on_start) {
+                on_start(proc.id());
+            }
+
             ios.run();
+
+            // WNOWAIT leaves the child for proc.wait() to reap - waitid()'s
+            // rusage argument is Linux only, so no libc wrapper
+            siginfo_t info{};
+            rusage usage{};
+
+            if (syscall(SYS_waitid,
+                        P_PID,
+                        proc.id(),
+                        &info,
+                        WEXITED | WNOWAIT,
+                        &usage)
+                == 0) {
+                out.peak_rss_kb = usage.ru_maxrss;
+                out.cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                                  + (usage.ru_utime.tv_usec
+                                     + usage.ru_stime.tv_usec)
+                                        / 1e6;
+            }
+
             proc.wait();
         } catch (bp::process_error &err) {
-            log("process error", "msg", err.what(), "code", err.code().value());
+            log_error(
+                "process error", "msg", err.what(), "code", err.code().value());
         }
 
         auto stderr_copy = stderr.get();
         auto stdout_copy = stdout.get();
-        // log("output", "stdout", stdout_copy, "stderr", stderr_copy);
+        log_trace("output", "stdout", stdout_copy, "stderr", stderr_copy);
         out.stderr
             = stderr_copy | rv::split('\n') | r::to<std::vector<std::string>>();
         out.stdout
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/ranges.h"
+
+#include "executable.hh"
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/**
+ * The one frontend job (clang -cc1) a driver command line expands to, with
+ * its input and output paths left to fill in per compile
+ *
+ * Resolved from the driver's `-###` dry run of the command, compiling
+ * placeholder paths - running the job directly then skips the driver's
+ * argument parsing and toolchain probing, and its process, for each compile.
+ */
+class frontend_command {
+public:
+    /**
+     * driver and args compiling input to output - run with -### in cwd.
+     * Empty unless the driver would run exactly one job: gcc, for one, runs
+     * cc1plus then as
+     */
+    static std::optional<frontend_command>
+    resolve(const std::string &driver,
+            std::vector<std::string> args,
+            const bfs::path &input,
+            const bfs::path &output,
+            const bfs::path &cwd) {
+        args.insert(args.begin(), "-###");
+
+        auto dry_run = executable{driver, args, cwd}.run();
+
+        if (dry_run.exit_code != 0) {
+            log_debug("driver dry run failed",
+                      "driver",
+                      driver,
+                      "output",
+                      dry_run.stderr);
+            return {};
+        }
+
+        std::vector<std::vector<std::string>> jobs;
+
+        // jobs are the lines of quoted args - the rest is version info, and
+        // " (in-process)" for a cc1 newer drivers would run without a fork
+        for (auto &line : dry_run.stderr) {
+            if (line.rfind(" \"", 0) == 0) {
+                jobs.push_back(parse_job(line));
+            }
+        }
+
+        if (jobs.size() != 1 || jobs.front().size() < 2
+            || jobs.front()[1] != "-cc1") {
+            log_debug("driver doesn't run a single frontend job",
+                      "driver",
+                      driver,
+                      "jobs",
+                      jobs.size());
+            return {};
+        }
+
+        auto job = std::move(jobs.front());
+        auto program = job.front();
+        job.erase(job.begin());
+
+        return frontend_command{program, std::move(job), input, output};
+    }
+
+    /** a job line of -### output - args quoted, with \ escaping \, " and $ */
+    static std::vector<std::string> parse_job(const std::string &line) {
+        std::vector<std::string> args;
+        std::optional<std::string> arg;
+
+        for (std::size_t i = 0; i < line.size(); i++) {
+            auto c = line[i];
+
+            if (!arg) {
+                if (c == '"') {
+                    arg.emplace();
+                }
+            } else if (c == '\\' && i + 1 < line.size()) {
+                *arg += line[++i];
+            } else if (c == '"') {
+                args.push_back(std::move(*arg));
+                arg.reset();
+            } else {
+                *arg += c;
+            }
+        }
+
+        return args;
+    }
+
+    const std::string &program() const { return _program; }
+
+    /**
+     * the job's args compiling input to output - the driver derives
+     * -main-file-name from the input, and -ftime-trace's file from the output
+     */
+    std::vector<std::string> args(const bfs::path &input,
+                                  const bfs::path &output) const {
+        auto args = _args;
+        auto output_stem = bfs::path{output}.replace_extension("");
+
+        for (auto &arg : args) {
+            _replace_all(arg, _input.native(), input.native());
+            _replace_all(arg, _output.native(), output.native());
+            _replace_all(arg, _output_stem.native(), output_stem.native());
+            _replace_all(arg,
+                         _input.filename().native(),
+                         input.filename().native());
+        }
+
+        return args;
+    }
+
+private:
+    std::string _program;
+    std::vector<std::string> _args;
+    bfs::path _input;
+    bfs::path _output;
+    bfs::path _output_stem;
+
+    frontend_command(std::string program,
+                     std::vector<std::string> args,
+                     bfs::path input,
+                     bfs::path output)
+        : _program{std::move(program)}
+        , _args{std::move(args)}
+        , _input{std::move(input)}
+        , _output{std::move(output)}
+        , _output_stem{bfs::path{_output}.replace_extension("")} {}
+
+    static void _replace_all(std::string &s,
+                             const std::string &from,
+                             const std::string &to) {
+        for (auto pos = s.find(from); pos != std::string::npos;
+             pos = s.find(from, pos + to.size())) {
+            s.replace(pos, from.size(), to);
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
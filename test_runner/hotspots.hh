@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "time_trace.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/**
+ * A template instantiation or class parse from clang's -ftime-trace, and how
+ * long clang spent in it (inclusive of anything nested inside it)
+ */
+struct template_hotspot {
+    std::string kind;
+    std::string detail;
+    std::chrono::microseconds duration;
+    unsigned long count = 1;
+
+    std::string to_string() const {
+        auto ms = duration.count() / 1000.0;
+
+        if (count > 1) {
+            return fmt::format("{:.1f}ms {} x{} {}", ms, kind, count, detail);
+        }
+
+        return fmt::format("{:.1f}ms {} {}", ms, kind, detail);
+    }
+};
+
+inline bool is_template_hotspot(const time_trace_event &event) {
+    return event.name == "InstantiateClass"
+           || event.name == "InstantiateFunction"
+           || event.name == "ParseClass";
+}
+
+/** the longest hotspots first */
+inline std::vector<template_hotspot>
+top_hotspots(std::vector<template_hotspot> hotspots, std::size_t n) {
+    auto end = hotspots.begin() + std::min(n, hotspots.size());
+
+    std::partial_sort(
+        hotspots.begin(), end, hotspots.end(), [](auto &a, auto &b) {
+            return a.duration > b.duration;
+        });
+
+    hotspots.erase(end, hotspots.end());
+
+    return hotspots;
+}
+
+inline std::vector<template_hotspot>
+template_hotspots(const std::vector<time_trace_event> &events) {
+    std::vector<template_hotspot> hotspots;
+
+    for (auto &event : events) {
+        if (is_template_hotspot(event)) {
+            hotspots.push_back({
+                event.name,
+                event.detail,
+                std::chrono::microseconds{static_cast<long>(event.dur)},
+            });
+        }
+    }
+
+    return hotspots;
+}
+
+/**
+ * Hotspots summed over every case in the run, by kind and template
+ *
+ * Each case re-instantiates the templates it uses, so a template that is
+ * cheap per case can still dominate a run with many cases
+ */
+class hotspot_totals {
+public:
+    void add(const std::vector<template_hotspot> &hotspots) {
+        std::lock_guard lock{_mutex};
+
+        for (auto &hotspot : hotspots) {
+            auto &total = _totals[{hotspot.kind, hotspot.detail}];
+            total.first += hotspot.duration;
+            total.second += hotspot.count;
+        }
+    }
+
+    std::vector<template_hotspot> top(std::size_t n) {
+        std::lock_guard lock{_mutex};
+
+        std::vector<template_hotspot> all;
+
+        for (auto &[key, total] : _totals) {
+            all.push_back({key.first, key.second, total.first, total.second});
+        }
+
+        return top_hotspots(std::move(all), n);
+    }
+
+private:
+    std::mutex _mutex;
+    std::map<std::pair<std::string, std::string>,
+             std::pair<std::chrono::microseconds, unsigned long>>
+        _totals;
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/**
+ * Client of a GNU make jobserver - caps compiler processes across every
+ * runner (and make, ninja, cargo, ...) sharing it, machine wide
+ *
+ * The jobserver is a pipe or named FIFO holding one byte per job slot.
+ * Clients read a byte for each job, and write it back when the job is done.
+ * make holds one byte less than its -j, as the job it started the runner
+ * for is the runner's first, so joined from MAKEFLAGS one compile may run
+ * without a token.  A --jobserver FIFO holds every slot, and each compile
+ * takes a token - otherwise every runner sharing it would run one more.
+ * See https://www.gnu.org/software/make/manual/html_node/POSIX-Jobserver.html
+ *
+ * One per runner - compiler processes take a token each from instance().
+ * Until connected, tokens are free and nothing is capped.
+ */
+class jobserver {
+public:
+    /** a job slot - held for as long as a compiler process runs */
+    class token {
+    public:
+        token() = default;
+
+        token(jobserver *owner, std::optional<char> byte)
+            : _owner{owner}
+            , _byte{byte} {}
+
+        token(token &&other)
+            : _owner{other._owner}
+            , _byte{other._byte} {
+            other._owner = nullptr;
+        }
+
+        token(const token &) = delete;
+        token &operator=(const token &) = delete;
+        token &operator=(token &&) = delete;
+
+        ~token() {
+            if (_owner) {
+                _owner->_release(_byte);
+            }
+        }
+
+    private:
+        jobserver *_owner = nullptr;
+        // empty for the implicit slot
+        std::optional<char> _byte;
+    };
+
+    static jobserver &instance() {
+        static jobserver j;
+        return j;
+    }
+
+    /**
+     * Join the jobserver named in MAKEFLAGS, if there is one -
+     * --jobserver-auth=fifo:<path>, or =<read fd>,<write fd> for a pipe
+     * inherited from make.  One compile may run without a token
+     */
+    bool connect_from_makeflags() {
+        auto makeflags = std::getenv("MAKEFLAGS");
+
+        if (!makeflags) {
+            return false;
+        }
+
+        const static std::regex fifo{R"(--jobserver-auth=fifo:(\S+))"};
+        const static std::regex fds{
+            R"(--jobserver-(?:auth|fds)=(-?\d+),(-?\d+))"};
+
+        std::cmatch match;
+        std::string flags = makeflags;
+
+        if (std::regex_search(makeflags, match, fifo)) {
+            _implicit_free = connect_fifo(match[1].str());
+            return _implicit_free;
+        }
+
+        if (std::regex_search(makeflags, match, fds)) {
+            auto read_fd = std::stoi(match[1]);
+            auto write_fd = std::stoi(match[2]);
+
+            // make closes them for commands it doesn't think are recursive
+            if (fcntl(read_fd, F_GETFD) < 0 || fcntl(write_fd, F_GETFD) < 0) {
+                log_warning("jobserver in MAKEFLAGS isn't open - run the "
+                            "runner from a '+' recipe line to inherit it",
+                            "makeflags",
+                            flags);
+                return false;
+            }
+
+            _connect(read_fd, write_fd, "makeflags pipe");
+            _implicit_free = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    /** join a jobserver FIFO - every compile takes a token */
+    bool connect_fifo(const std::string &path) {
+        auto fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+
+        if (fd < 0) {
+            log_error("could not open jobserver",
+                      "fifo",
+                      path,
+                      "error",
+                      strerror(errno));
+            return false;
+        }
+
+        _connect(fd, fd, path);
+        return true;
+    }
+
+    bool connected() const { return _read_fd >= 0; }
+
+    /** block until a job may start */
+    token acquire() {
+        if (!connected()) {
+            return {};
+        }
+
+        {
+            std::lock_guard lock{_mutex};
+
+            if (_implicit_free) {
+                _implicit_free = false;
+                return {this, std::nullopt};
+            }
+        }
+
+        char byte;
+
+        while (true) {
+            auto read = ::read(_read_fd, &byte, 1);
+
+            if (read == 1) {
+                return {this, byte};
+            }
+
+            if (read < 0 && errno == EINTR) {
+                continue;
+            }
+
+            // make may leave its pipe non-blocking - wait for a token there
+            if (read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                auto readable = pollfd{_read_fd, POLLIN, 0};
+                ::poll(&readable, 1, -1);
+                continue;
+            }
+
+            // a jobserver gone away caps nothing
+            log_error("could not read jobserver token",
+                      "error",
+                      read == 0 ? "closed" : strerror(errno));
+            return {};
+        }
+    }
+
+private:
+    int _read_fd = -1;
+    int _write_fd = -1;
+    std::mutex _mutex;
+    // whether the one compile make allows without a token isn't running
+    bool _implicit_free = false;
+
+    jobserver() = default;
+
+    void _connect(int read_fd, int write_fd, const std::string &name) {
+        _read_fd = read_fd;
+        _write_fd = write_fd;
+
+        log_debug("joined jobserver", "jobserver", name);
+    }
+
+    void _release(std::optional<char> byte) {
+        if (!byte) {
+            std::lock_guard lock{_mutex};
+            _implicit_free = true;
+            return;
+        }
+
+        // tokens must go back, or the other clients lose a slot for good
+        while (::write(_write_fd, &*byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
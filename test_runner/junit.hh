@@ -1,24 +1,28 @@
 #pragma once
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <ostream>
 #include <string>
 
 #include "boost/filesystem.hpp"
 #include "fmt/core.h"
+#include "fmt/ranges.h"
 #include "log.hh"
 #include "range/v3/all.hpp"
 #include "test_runner/test_suite_run.hh"
 #include "tinyxml2.h"
 
+#include "spill.hh"
 #include "test_case_run.hh"
 #include "util.hh"
 
 namespace dhagedorn::comp_test::impl {
 
-#include "boost/filesystem.hpp"
-
 using namespace std::chrono_literals;
 
 namespace bfs = boost::filesystem;
@@ -34,41 +38,97 @@ https://github.com/bazelbuild/bazel/blob/master/src/java_tools/junitrunner/java/
 time="1"></testcase>
 */
 
+/**
+ * Streaming JUnit writer
+ *
+ * Cases are written as they finish, and the file on disk is kept well-formed
+ * after every write - the closing tags are always present after the last
+ * case, and each new case is written over them together with a fresh copy of
+ * the closing tags.  If the runner is killed (ex, Bazel test timeout), the
+ * test.xml holds every case that finished so far.
+ *
+ * Each write is a single pwrite(), so there's no window in which a signal can
+ * leave a partial file behind.  The open <testsuite> tag is written with
+ * room to spare so its counts can be patched in place as cases finish.
+ */
 class junit {
 public:
-    auto write(const std::vector<test_suite_run> &runs, bfs::path path) {
-
-        FILE *fout = fopen(path.c_str(), "wb");
-
-        if (!fout) {
+    junit(bfs::path path)
+        : _fd{::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0644)} {
+        if (_fd < 0) {
             // TODO XML_OUTPUT_FILE relative to workspace root, but we're not
             // running from there!
             std::cerr << path << strerror(errno) << std::endl;
-            // throw "could not open";
+            return;
         }
 
-        auto cleanup = defer{[&] {
-            if (fout) {
-                fclose(fout);
-            }
-        }};
+        tinyxml2::XMLPrinter p{nullptr, true};
+        p.PushHeader(false, true);
 
-        tinyxml2::XMLPrinter p{fout};
+        _append(fmt::format("{}\n<testsuites>\n", p.CStr()), _close_all);
+    }
 
-        p.PushHeader(false, true);
+    junit(const junit &) = delete;
+    junit &operator=(const junit &) = delete;
+
+    ~junit() {
+        if (_fd >= 0) {
+            ::fsync(_fd);
+            ::close(_fd);
+        }
+    }
+
+    void begin_suite(const test_suite_run &run) {
+        auto header = _suite_header(run);
+        header.append(_header_slack, ' ');
+        header.push_back('>');
 
-        p.OpenElement("testsuites");
+        _header_offset = _end;
+        _header_size = header.size();
 
-        for (const auto &suite : runs) {
-            _start_suite(suite, p);
+        _append(header + "\n", _close_suite + _close_all);
+    }
+
+    void add_case(const test_suite_run &run, const testcase_run &tc) {
+        if (tc.compiler_output && tc.compiler_output->spilled) {
+            _append_spilled_case(tc, *tc.compiler_output->spilled);
+        } else {
+            _append(_case(tc), _close_suite + _close_all);
         }
 
-        p.CloseElement();
+        auto header = _suite_header(run);
+
+        if (header.size() + 1 > _header_size) {
+            return; // shouldn't happen - counts would have to grow by
+                    // _header_slack digits
+        }
+
+        header.append(_header_size - header.size() - 1, ' ');
+        header.push_back('>');
 
-        fflush(fout);
+        _pwrite(header, _header_offset);
+    }
+
+    void end_suite() {
+        // closing tag is already on disk - just keep it
+        _end += _close_suite.size();
     }
 
 private:
+    inline const static std::string _close_suite = "  </testsuite>\n";
+    inline const static std::string _close_all = "</testsuites>\n";
+    constexpr static std::size_t _header_slack = 64;
+    // where spilled output goes in a case's XML
+    inline const static std::string _out_marker = "\x01spilled stdout\x01";
+    inline const static std::string _err_marker = "\x01spilled stderr\x01";
+    constexpr static std::size_t _spill_chunk = 64 * 1024;
+
+    int _fd;
+    off_t _end = 0;
+    off_t _header_offset = 0;
+    std::size_t _header_size = 0;
+
     template <typename T>
     auto _sec(T &&val) {
         return 1.0f
@@ -77,7 +137,96 @@ private:
                / 1000;
     };
 
-    void _start_suite(const test_suite_run &run, tinyxml2::XMLPrinter &p) {
+    /** write content at the current end, followed by tail, which the next
+     * write will overwrite */
+    void _append(const std::string &content, const std::string &tail) {
+        _pwrite(content + tail, _end);
+        _end += content.size();
+    }
+
+    void _pwrite(const std::string &content, off_t offset) {
+        if (_fd < 0) {
+            return;
+        }
+
+        auto written = ::pwrite(_fd, content.data(), content.size(), offset);
+
+        if (written != static_cast<ssize_t>(content.size())) {
+            std::cerr << "junit write failed: " << strerror(errno)
+                      << std::endl;
+        }
+    }
+
+    /**
+     * Write a case with spilled output, streaming the output back from disk
+     * in chunks
+     *
+     * Each chunk is written with the closing tags for wherever it leaves off
+     * - the rest of the <system-out>/<system-err> CDATA and <testcase>, then
+     * the suite - so the file stays well-formed between chunks too
+     */
+    void _append_spilled_case(const testcase_run &run,
+                              const spilled_output &spilled) {
+        auto xml = _case(run);
+
+        auto out_at = xml.find(_out_marker);
+        auto err_at = xml.find(_err_marker);
+
+        auto before_out = xml.substr(0, out_at);
+        auto between = xml.substr(out_at + _out_marker.size(),
+                                  err_at - out_at - _out_marker.size());
+        auto after_err = xml.substr(err_at + _err_marker.size());
+
+        auto tail = _close_suite + _close_all;
+
+        _append(before_out, between + after_err + tail);
+        _stream(spilled.out(), between + after_err + tail);
+        _append(between, after_err + tail);
+        _stream(spilled.err(), after_err + tail);
+        _append(after_err, tail);
+    }
+
+    /** append the lines of a spilled file inside a CDATA section */
+    void _stream(const bfs::path &path, const std::string &tail) {
+        std::string chunk;
+        bool first = true;
+
+        spilled_output::for_each_line(path, [&](const std::string &line) {
+            if (!first) {
+                chunk += '\n';
+            }
+
+            first = false;
+
+            chunk += _cdata(line);
+
+            if (chunk.size() >= _spill_chunk) {
+                _append(chunk, tail);
+                chunk.clear();
+            }
+        });
+
+        _append(chunk, tail);
+    }
+
+    /** text, safe inside a CDATA section */
+    static std::string _cdata(std::string text) {
+        // "]]>" would end the CDATA section - split it across two
+        const std::string end = "]]>";
+        const std::string split = "]]]]><![CDATA[>";
+
+        for (auto at = text.find(end); at != std::string::npos;
+             at = text.find(end, at + split.size())) {
+            text.replace(at, end.size(), split);
+        }
+
+        return text;
+    }
+
+    /** opening <testsuite> tag, without the closing '>' */
+    std::string _suite_header(const test_suite_run &run) {
+        tinyxml2::XMLPrinter p{nullptr, true};
+
         p.OpenElement("testsuite");
 
         p.PushAttribute("name",
@@ -85,19 +234,122 @@ private:
                                     run.test_suite.name,
                                     run.test_suite.description)
                             .c_str());
-        p.PushAttribute("tests", run.case_runs.size());
+        p.PushAttribute("tests", run.tests());
         p.PushAttribute("failures", run.failed());
         p.PushAttribute("errors", run.errors());
         p.PushAttribute("time", _sec(run.duration()));
 
-        for (auto &tc : run.case_runs) {
-            _add_tc(tc, p);
+        return "  "s + p.CStr();
+    }
+
+    /** a COMP_SCALING case's curve - CPU ms per size, and the fit */
+    static void _scaling_properties(tinyxml2::XMLPrinter &p,
+                                    const scaling_result &scaling) {
+        auto property = [&](const std::string &name,
+                            const std::string &value) {
+            p.OpenElement("property");
+            p.PushAttribute("name", name.c_str());
+            p.PushAttribute("value", value.c_str());
+            p.CloseElement();
+        };
+
+        for (auto &point : scaling.fit.curve) {
+            property(fmt::format("scaling.cpu_ms.{}", point.size),
+                     fmt::format("{:.1f}", point.cpu_ms));
         }
 
-        p.CloseElement();
+        property("scaling.bound", to_string(scaling.bound));
+        property("scaling.fit", scaling.fit.to_string());
+    }
+
+    /** a COMP_BUDGET case's counts, and what they were allowed */
+    static void _budget_properties(tinyxml2::XMLPrinter &p,
+                                   const budget_result &budget) {
+        auto property = [&](const std::string &name,
+                            const std::optional<unsigned long> &count,
+                            unsigned long limit,
+                            const std::string &uncounted) {
+            auto value = fmt::format(
+                "{} of {}", count ? std::to_string(*count) : uncounted, limit);
+
+            p.OpenElement("property");
+            p.PushAttribute("name", name.c_str());
+            p.PushAttribute("value", value.c_str());
+            p.CloseElement();
+        };
+
+        if (budget.spec.instantiations) {
+            property("budget.instantiations",
+                     budget.instantiations,
+                     *budget.spec.instantiations,
+                     "unknown");
+        }
+
+        if (budget.spec.constexpr_steps) {
+            property("budget.constexpr_steps",
+                     budget.constexpr_steps,
+                     *budget.spec.constexpr_steps,
+                     "over budget");
+        }
+    }
+
+    /** a COMP_CODE_SIZE case's code, and the functions it's in */
+    static void _code_size_properties(tinyxml2::XMLPrinter &p,
+                                      const code_size_result &code_size) {
+        auto property = [&](const std::string &name,
+                            const std::string &value) {
+            p.OpenElement("property");
+            p.PushAttribute("name", name.c_str());
+            p.PushAttribute("value", value.c_str());
+            p.CloseElement();
+        };
+
+        property("code_size.text_bytes",
+                 fmt::format("{} of {}",
+                             code_size.text_bytes
+                                 ? std::to_string(*code_size.text_bytes)
+                                 : "unknown",
+                             code_size.spec.text_bytes));
+
+        for (auto &function : code_size.functions) {
+            property(fmt::format("code_size.bytes.{}", function.name),
+                     std::to_string(function.bytes));
+        }
+    }
+
+    /** where a MUST_VECTORIZE or MUST_INLINE case was optimized, and not */
+    static void _optimization_properties(tinyxml2::XMLPrinter &p,
+                                         const optimization_result &result) {
+        auto property = [&](const std::string &name,
+                            const std::vector<std::string> &places) {
+            p.OpenElement("property");
+            p.PushAttribute("name", name.c_str());
+            p.PushAttribute("value",
+                            fmt::format("{}", fmt::join(places, "; ")).c_str());
+            p.CloseElement();
+        };
+
+        property("optimization.applied", result.applied);
+        property("optimization.missed", result.missed);
     }
 
-    void _add_tc(const testcase_run &run, tinyxml2::XMLPrinter &p) {
+    /** each forbidden symbol a MUST_NOT_REFERENCE case refers to */
+    static void _reference_properties(tinyxml2::XMLPrinter &p,
+                                      const reference_result &references) {
+        for (auto &reference : references.found) {
+            p.OpenElement("property");
+            p.PushAttribute(
+                "name",
+                fmt::format("references.{}", reference.symbol).c_str());
+            p.PushAttribute("value", std::to_string(reference.count).c_str());
+            p.CloseElement();
+        }
+    }
+
+    /** a whole <testcase>, with markers in place of any spilled output */
+    std::string _case(const testcase_run &run) {
+        tinyxml2::XMLPrinter p{nullptr, false, 2};
+
         p.OpenElement("testcase");
         p.PushAttribute("classname", run.tc.object.c_str());
         p.PushAttribute("name", run.tc.verb.c_str());
@@ -108,6 +360,41 @@ private:
         p.PushAttribute("duration", _sec(run.duration));
         p.PushAttribute("time", _sec(run.duration));
 
+        if (!run.hotspots.empty() || run.scaling || run.budget
+            || run.code_size || run.optimization || run.references) {
+            p.OpenElement("properties");
+
+            for (std::size_t i = 0; i < run.hotspots.size(); i++) {
+                p.OpenElement("property");
+                p.PushAttribute(
+                    "name", fmt::format("template_hotspot.{}", i + 1).c_str());
+                p.PushAttribute("value", run.hotspots[i].to_string().c_str());
+                p.CloseElement();
+            }
+
+            if (run.scaling) {
+                _scaling_properties(p, *run.scaling);
+            }
+
+            if (run.budget) {
+                _budget_properties(p, *run.budget);
+            }
+
+            if (run.code_size) {
+                _code_size_properties(p, *run.code_size);
+            }
+
+            if (run.optimization) {
+                _optimization_properties(p, *run.optimization);
+            }
+
+            if (run.references) {
+                _reference_properties(p, *run.references);
+            }
+
+            p.CloseElement();
+        }
+
         if (run.result() == test_case_result::error) {
             p.OpenElement("error");
             p.PushAttribute("message", run.fail_or_error_message()->c_str());
@@ -118,23 +405,32 @@ private:
             p.CloseElement();
         }
 
-        if (run.result() == test_case_result::error
-            || run.result() == test_case_result::fail) {
+        // decided cases have no compiler output
+        if (run.compiler_output
+            && (run.result() == test_case_result::error
+                || run.result() == test_case_result::fail)) {
+            auto &output = *run.compiler_output;
+
+            auto out = output.spilled
+                           ? _out_marker
+                           : _cdata(output.compile_output.stdout | join('\n'));
+            auto err = output.spilled
+                           ? _err_marker
+                           : _cdata(output.compile_output.stderr | join('\n'));
+
             p.OpenElement("system-out");
-            p.PushText((run.compiler_output->compile_output.stdout | join('\n'))
-                           .c_str(),
-                       true);
+            p.PushText(out.c_str(), true);
             p.CloseElement();
 
             p.OpenElement("system-err");
-            p.PushText((run.compiler_output->compile_output.stderr | join('\n'))
-                           .c_str(),
-                       true);
+            p.PushText(err.c_str(), true);
             p.CloseElement();
         }
 
         p.CloseElement();
+
+        return fmt::format("    {}\n", p.CStr());
     }
 };
 
-} // namespace dhagedorn::comp_test::impl
\ No newline at end of file
+} // namespace dhagedorn::comp_test::impl
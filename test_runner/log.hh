@@ -1,14 +1,77 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <typeinfo>
 
 #include "fmt/color.h"
 #include "fmt/core.h"
 #include "fmt/format.h"
 
+/**
+ * Lowest log level compiled in - anything below this is removed at compile
+ * time.  0 = trace, 1 = debug, 2 = info, 3 = warning, 4 = error, 5 = off
+ */
+#ifndef COMP_TEST_LOG_LEVEL
+#define COMP_TEST_LOG_LEVEL 0
+#endif
+
 namespace dhagedorn::comp_test::impl {
 
+enum class log_level {
+    trace,
+    debug,
+    info,
+    warning,
+    error,
+    off,
+};
+
+constexpr log_level compiled_log_level
+    = static_cast<log_level>(COMP_TEST_LOG_LEVEL);
+
+constexpr const char *to_string(log_level level) {
+    switch (level) {
+        case log_level::trace:
+            return "trace";
+        case log_level::debug:
+            return "debug";
+        case log_level::info:
+            return "info";
+        case log_level::warning:
+            return "warning";
+        case log_level::error:
+            return "error";
+        case log_level::off:
+            return "off";
+    }
+
+    return "unknown";
+}
+
+inline std::optional<log_level> log_level_from_string(const std::string &s) {
+    for (auto level : {log_level::trace,
+                       log_level::debug,
+                       log_level::info,
+                       log_level::warning,
+                       log_level::error,
+                       log_level::off}) {
+        if (s == to_string(level)) {
+            return level;
+        }
+    }
+
+    return {};
+}
+
 template <std::size_t N>
 constexpr auto is_string_literal(const char (&)[N]) {
     return true;
@@ -60,45 +123,181 @@ struct is_optional<std::optional<T>> : std::true_type {};
 template <typename T>
 constexpr bool is_optional_v = is_optional<T>{};
 
+/**
+ * Background writer for log output
+ *
+ * Callers format their message and hand it off - only the sink thread ever
+ * touches stdout, so workers never block on terminal I/O, and each message is
+ * written whole rather than interleaved with others
+ */
+class log_sink {
+public:
+    static log_sink &instance() {
+        static log_sink sink;
+        return sink;
+    }
+
+    void push(std::string message) {
+        {
+            std::lock_guard lock{_mutex};
+            _queue.push_back(std::move(message));
+        }
+
+        _cv.notify_one();
+    }
+
+    ~log_sink() {
+        {
+            std::lock_guard lock{_mutex};
+            _stop = true;
+        }
+
+        _cv.notify_one();
+        _thread.join();
+    }
+
+private:
+    log_sink()
+        : _thread{[this] { _run(); }} {}
+
+    void _run() {
+        std::deque<std::string> pending;
+
+        while (true) {
+            {
+                std::unique_lock lock{_mutex};
+                _cv.wait(lock, [&] { return _stop || !_queue.empty(); });
+
+                if (_queue.empty() && _stop) {
+                    return;
+                }
+
+                pending.swap(_queue);
+            }
+
+            for (auto &message : pending) {
+                std::fwrite(message.data(), 1, message.size(), stdout);
+            }
+
+            std::fflush(stdout);
+            pending.clear();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::string> _queue;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+inline bool colour_enabled = true;
+inline void log_enable_colour(bool enabled) { colour_enabled = enabled; }
+
+inline std::atomic<log_level> runtime_log_level = log_level::info;
+inline void log_set_level(log_level level) { runtime_log_level = level; }
+
+template <log_level LEVEL>
+bool log_enabled() {
+    if constexpr (LEVEL < compiled_log_level) {
+        return false;
+    } else {
+        return LEVEL >= runtime_log_level.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename... ARGS>
+void log_styled(std::string &out,
+                fmt::color colour,
+                const char *format,
+                ARGS &&...args) {
+    if (colour_enabled) {
+        fmt::format_to(std::back_inserter(out),
+                       fmt::fg(colour),
+                       format,
+                       std::forward<ARGS>(args)...);
+    } else {
+        fmt::format_to(
+            std::back_inserter(out), format, std::forward<ARGS>(args)...);
+    }
+}
+
 template <typename K, typename V, typename... REST>
-void log_fields(K &&k, V &&v, REST &&...rest) {
+void log_fields(std::string &out, K &&k, V &&v, REST &&...rest) {
     using DECAYED_V = std::decay_t<V>;
 
     static_assert(sizeof...(REST) % 2 == 0,
                   "rest... must contain an even "
                   "number of args");
 
-    fmt::print("  {:<20} -> ", std::forward<K>(k));
+    fmt::format_to(
+        std::back_inserter(out), "  {:<20} -> ", std::forward<K>(k));
 
     if constexpr (is_optional_v<DECAYED_V>) {
         if (v) {
-            fmt::print(fmt::fg(color_for<typename DECAYED_V::value_type>()),
+            log_styled(out,
+                       color_for<typename DECAYED_V::value_type>(),
                        "{}\n",
                        std::forward<typename DECAYED_V::value_type>(*v));
         } else {
-            fmt::print(fmt::fg(color_for<typename DECAYED_V::value_type>()),
+            log_styled(out,
+                       color_for<typename DECAYED_V::value_type>(),
                        "<empty {}>\n",
                        typeid(DECAYED_V).name());
         }
     } else {
-        fmt::print(fmt::fg(color_for<V>()), "{}\n", std::forward<V>(v));
+        log_styled(out, color_for<V>(), "{}\n", std::forward<V>(v));
     }
 
     if constexpr (sizeof...(REST) > 0) {
-        log_fields(rest...);
+        log_fields(out, rest...);
     }
 }
 
-inline bool colour_enabled = false;
-void log_enable_colour(bool enabled) { colour_enabled = enabled; }
+/**
+ * Log msg followed by key/value fields at LEVEL
+ *
+ * Nothing is formatted unless LEVEL is enabled both at compile time
+ * (COMP_TEST_LOG_LEVEL) and at run time (log_set_level())
+ */
+template <log_level LEVEL, typename... ARGS>
+void log_at(const char *msg, ARGS &&...args) {
+    if (!log_enabled<LEVEL>()) {
+        return;
+    }
 
-template <typename... ARGS>
-void log(const char *msg, ARGS &&...args) {
-    fmt::print("{}\n", msg);
+    std::string out = fmt::format("{}\n", msg);
 
     if constexpr (sizeof...(ARGS) > 0) {
-        log_fields(std::forward<ARGS>(args)...);
+        log_fields(out, std::forward<ARGS>(args)...);
     }
+
+    log_sink::instance().push(std::move(out));
+}
+
+template <typename... ARGS>
+void log(const char *msg, ARGS &&...args) {
+    log_at<log_level::info>(msg, std::forward<ARGS>(args)...);
+}
+
+template <typename... ARGS>
+void log_trace(const char *msg, ARGS &&...args) {
+    log_at<log_level::trace>(msg, std::forward<ARGS>(args)...);
+}
+
+template <typename... ARGS>
+void log_debug(const char *msg, ARGS &&...args) {
+    log_at<log_level::debug>(msg, std::forward<ARGS>(args)...);
+}
+
+template <typename... ARGS>
+void log_warning(const char *msg, ARGS &&...args) {
+    log_at<log_level::warning>(msg, std::forward<ARGS>(args)...);
+}
+
+template <typename... ARGS>
+void log_error(const char *msg, ARGS &&...args) {
+    log_at<log_level::error>(msg, std::forward<ARGS>(args)...);
 }
 
-} // namespace dhagedorn::comp_test::impl
\ No newline at end of file
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/core.h"
+
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+using namespace std::chrono_literals;
+
+/** MemAvailable from /proc/meminfo, in KiB */
+inline std::optional<long> mem_available_kb() {
+    std::ifstream fin{"/proc/meminfo"};
+
+    for (std::string key; fin >> key;) {
+        long value;
+        std::string unit;
+        fin >> value >> unit;
+
+        if (key == "MemAvailable:") {
+            return value;
+        }
+    }
+
+    return {};
+}
+
+/**
+ * "full avg10" from /proc/pressure/memory - the share of the last 10s in
+ * which every task was stalled on memory.  Empty if PSI isn't enabled
+ */
+inline std::optional<double> memory_pressure_full() {
+    std::ifstream fin{"/proc/pressure/memory"};
+
+    for (std::string line; std::getline(fin, line);) {
+        if (line.rfind("full ", 0) != 0) {
+            continue;
+        }
+
+        auto avg10 = line.find("avg10=");
+
+        if (avg10 != std::string::npos) {
+            return std::stod(line.substr(avg10 + 6));
+        }
+    }
+
+    return {};
+}
+
+/** pid and all of its descendants, from /proc/<pid>/stat */
+inline std::vector<int> process_tree(int root) {
+    std::multimap<int, int> children;
+
+    for (auto &entry : bfs::directory_iterator{"/proc"}) {
+        auto name = entry.path().filename().native();
+
+        if (name.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+
+        std::ifstream fin{(entry.path() / "stat").native()};
+        std::string stat;
+        std::getline(fin, stat);
+
+        // the command name can hold spaces and ')' - fields start after the
+        // last ')'
+        auto fields = stat.rfind(')');
+
+        if (fields == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream in{stat.substr(fields + 2)};
+        std::string state;
+        int ppid = 0;
+        in >> state >> ppid;
+
+        children.emplace(ppid, std::stoi(name));
+    }
+
+    std::vector<int> tree = {root};
+
+    for (std::size_t i = 0; i < tree.size(); i++) {
+        auto [begin, end] = children.equal_range(tree[i]);
+
+        for (auto it = begin; it != end; it++) {
+            tree.push_back(it->second);
+        }
+    }
+
+    return tree;
+}
+
+/** resident memory of pid and its descendants, in KiB */
+inline long process_tree_rss_kb(int root) {
+    static const auto page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+    long total = 0;
+
+    for (auto pid : process_tree(root)) {
+        std::ifstream fin{fmt::format("/proc/{}/statm", pid)};
+        long size = 0;
+        long resident = 0;
+
+        if (fin >> size >> resident) {
+            total += resident * page_kb;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * Peak compiler memory for each case, from earlier runs
+ *
+ * One "<peak KiB>\t<case>" line per case - kept in a file between runs with
+ * --memory-profile
+ */
+class memory_profile {
+public:
+    void load(const bfs::path &path) {
+        std::ifstream fin{path.native()};
+
+        std::lock_guard lock{_mutex};
+
+        for (std::string line; std::getline(fin, line);) {
+            auto tab = line.find('\t');
+
+            if (tab != std::string::npos) {
+                _peaks[line.substr(tab + 1)] = std::stol(line.substr(0, tab));
+            }
+        }
+    }
+
+    void save(const bfs::path &path) const {
+        std::ofstream fout{path.native()};
+
+        if (!fout.is_open()) {
+            log_error("could not write memory profile", "path", path.native());
+            return;
+        }
+
+        std::lock_guard lock{_mutex};
+
+        for (auto &[key, kb] : _peaks) {
+            fout << kb << '\t' << key << '\n';
+        }
+    }
+
+    /** peak for a case in an earlier run, if it has run before */
+    std::optional<long> peak_kb(const std::string &key) const {
+        std::lock_guard lock{_mutex};
+
+        if (auto found = _peaks.find(key); found != _peaks.end()) {
+            return found->second;
+        }
+
+        return {};
+    }
+
+    void record(const std::string &key, long peak_kb) {
+        std::lock_guard lock{_mutex};
+        _peaks[key] = peak_kb;
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::map<std::string, long> _peaks;
+};
+
+/**
+ * Decides when a compile may start, from how much memory is free
+ *
+ * A compile starts once MemAvailable, less what the running compiles are
+ * still expected to grow by, covers its estimate with reserve to spare, and
+ * the kernel isn't reporting memory stalls (PSI).  So compiles run as
+ * concurrently as memory allows, up to --jobs.
+ *
+ * While compiles run, their process trees are sampled.  If MemAvailable
+ * still drops below half the reserve, the compile using the most is killed
+ * before the OOM killer picks something itself.  Its case is retried alone,
+ * and fails if it runs out alone as well.
+ */
+class memory_governor {
+public:
+    /** a running (or waiting to run) compile */
+    class slot {
+    public:
+        slot(memory_governor &governor, long estimate_kb, bool alone)
+            : _governor{governor}
+            , _estimate_kb{estimate_kb}
+            , _alone{alone} {}
+
+        slot(const slot &) = delete;
+        slot &operator=(const slot &) = delete;
+
+        ~slot() { _governor._release(*this); }
+
+        /** pass as the compile's on_start */
+        void started(int pid) {
+            std::lock_guard lock{_governor._mutex};
+            _pid = pid;
+        }
+
+        bool killed() const {
+            std::lock_guard lock{_governor._mutex};
+            return _killed;
+        }
+
+    private:
+        friend class memory_governor;
+
+        memory_governor &_governor;
+        long _estimate_kb;
+        bool _alone;
+        int _pid = 0;
+        long _rss_kb = 0;
+        bool _killed = false;
+    };
+
+    memory_governor(long reserve_kb)
+        : _reserve_kb{reserve_kb}
+        , _sampler{[this] { _sample(); }} {}
+
+    memory_governor(const memory_governor &) = delete;
+    memory_governor &operator=(const memory_governor &) = delete;
+
+    ~memory_governor() {
+        {
+            std::lock_guard lock{_mutex};
+            _stopping = true;
+        }
+
+        _cv.notify_all();
+        _sampler.join();
+    }
+
+    /**
+     * Wait until a compile expected to peak at estimate_kb can start, or
+     * return nothing if it can't fit even with no other compile running
+     *
+     * estimate_kb: empty for a case never seen before - it's assumed to be
+     * large, but is always given a try
+     * alone: wait for every other compile to finish, and start none until
+     * this one does - no others start while it waits, so it can't be starved
+     */
+    std::unique_ptr<slot> acquire(std::optional<long> estimate_kb,
+                                  bool alone = false) {
+        auto needs = estimate_kb.value_or(_unknown_estimate_kb);
+
+        std::unique_lock lock{_mutex};
+
+        _waiting_alone += alone;
+
+        while (true) {
+            auto available = mem_available_kb().value_or(0);
+            auto held_back = !alone && _waiting_alone > 0;
+
+            if (_running.empty() && !_exclusive && !held_back) {
+                _waiting_alone -= alone;
+
+                if (estimate_kb && available - _reserve_kb < needs) {
+                    log_error("not enough memory to compile case",
+                              "needs (MiB)",
+                              needs / 1024,
+                              "available (MiB)",
+                              available / 1024,
+                              "reserve (MiB)",
+                              _reserve_kb / 1024);
+                    return {};
+                }
+
+                return _start(needs, alone);
+            }
+
+            auto headroom = available - _reserve_kb - _growth_kb();
+            auto stalled = memory_pressure_full().value_or(0) > _max_stall;
+
+            if (!alone && !held_back && !_exclusive && !stalled
+                && headroom >= needs) {
+                return _start(needs, alone);
+            }
+
+            // memory frees up as other compiles finish, or as other
+            // processes on the machine exit
+            _cv.wait_for(lock, _poll);
+        }
+    }
+
+private:
+    // PSI "full avg10" above this holds back new compiles
+    constexpr static double _max_stall = 10.0;
+    constexpr static auto _poll = 250ms;
+    constexpr static long _unknown_estimate_kb = 1024 * 1024;
+
+    long _reserve_kb;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::set<slot *> _running;
+    bool _exclusive = false;
+    // alone compiles waiting for the others to finish
+    int _waiting_alone = 0;
+    bool _stopping = false;
+    std::thread _sampler;
+
+    std::unique_ptr<slot> _start(long estimate_kb, bool alone) {
+        auto started = std::make_unique<slot>(*this, estimate_kb, alone);
+
+        _running.insert(started.get());
+        _exclusive = alone;
+
+        return started;
+    }
+
+    void _release(slot &done) {
+        {
+            std::lock_guard lock{_mutex};
+
+            if (_running.erase(&done) && done._alone) {
+                _exclusive = false;
+            }
+        }
+
+        _cv.notify_all();
+    }
+
+    /** how much more the running compiles are expected to use */
+    long _growth_kb() const {
+        long growth = 0;
+
+        for (auto *running : _running) {
+            growth += std::max(0L, running->_estimate_kb - running->_rss_kb);
+        }
+
+        return growth;
+    }
+
+    void _sample() {
+        std::unique_lock lock{_mutex};
+
+        while (!_stopping) {
+            _cv.wait_for(lock, _poll);
+
+            std::vector<std::pair<slot *, int>> pids;
+
+            for (auto *running : _running) {
+                if (running->_pid > 0 && !running->_killed) {
+                    pids.emplace_back(running, running->_pid);
+                }
+            }
+
+            if (pids.empty()) {
+                continue;
+            }
+
+            // /proc is slow to walk - don't hold up acquire() meanwhile
+            lock.unlock();
+
+            std::vector<long> rss;
+
+            for (auto &[_, pid] : pids) {
+                rss.push_back(process_tree_rss_kb(pid));
+            }
+
+            auto available = mem_available_kb();
+
+            lock.lock();
+
+            slot *largest = nullptr;
+
+            for (std::size_t i = 0; i < pids.size(); i++) {
+                if (!_running.count(pids[i].first)) {
+                    continue; // finished while sampling
+                }
+
+                pids[i].first->_rss_kb = rss[i];
+
+                if (!largest || rss[i] > largest->_rss_kb) {
+                    largest = pids[i].first;
+                }
+            }
+
+            if (largest && available && *available < _reserve_kb / 2) {
+                log_warning("memory nearly exhausted - killing a compile",
+                            "available (MiB)",
+                            *available / 1024,
+                            "compile RSS (MiB)",
+                            largest->_rss_kb / 1024);
+
+                largest->_killed = true;
+
+                for (auto pid : process_tree(largest->_pid)) {
+                    ::kill(pid, SIGKILL);
+                }
+            }
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
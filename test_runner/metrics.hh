@@ -0,0 +1,403 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/core.h"
+
+#include "compiler.hh"
+#include "executable.hh"
+#include "log.hh"
+#include "test_case_run.hh"
+#include "test_target.hh"
+#include "util.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/** what one case's compile cost */
+struct case_metrics {
+    std::string source;
+    std::string suite;
+    std::string symbol;
+    std::string object;
+    std::string verb;
+    test_case_result result;
+    std::chrono::milliseconds wall;
+    double cpu_seconds;
+    long peak_rss_kb;
+    // lines of compiler output, before any were dropped
+    std::size_t diagnostic_lines;
+    // compiled at all - decided cases aren't
+    bool compiled;
+    // the compile it reports used the source's precompiled header
+    bool pch;
+
+    /** call before the run's output is retained - it may be dropped */
+    static case_metrics of(const test_target &target,
+                           const testcase_run &run) {
+        static const executable_output not_compiled{};
+
+        auto &output = run.compiler_output
+                           ? run.compiler_output->compile_output
+                           : not_compiled;
+
+        return {
+            target.source,
+            run.tc.test_suite_symbol(),
+            run.tc.symbol,
+            run.tc.object,
+            run.tc.verb,
+            run.result(),
+            run.duration,
+            output.cpu_seconds,
+            output.peak_rss_kb,
+            output.stdout.size() + output.stderr.size(),
+            run.compiler_output.has_value(),
+            run.compiler_output && run.compiler_output->pch,
+        };
+    }
+};
+
+/** one source's discovery, and what its cases were compiled with */
+struct source_metrics {
+    std::string source;
+    std::string compiler;
+    std::string compiler_version;
+    std::string flags_hash;
+    std::chrono::milliseconds discovery;
+};
+
+/**
+ * Per-case and per-run costs, for tracking compile time across commits
+ *
+ * Written as JSON, or as CSV with one row per case if the path ends in
+ * .csv - with the run's totals in a one row <name>.run.csv beside it.  Cases
+ * and sources are added from the workers as they finish.
+ */
+class run_metrics {
+public:
+    run_metrics(std::size_t jobs)
+        : _jobs{jobs} {}
+
+    void add_source(const test_target &target,
+                    std::chrono::milliseconds discovery) {
+        auto version = compiler_version(target);
+
+        std::lock_guard lock{_mutex};
+
+        _sources.push_back({
+            target.source,
+            target.compiler,
+            version,
+            flags_hash(target.compiler_args),
+            discovery,
+        });
+    }
+
+    void add_case(case_metrics metrics) {
+        std::lock_guard lock{_mutex};
+        _cases.push_back(std::move(metrics));
+    }
+
+    void write(const bfs::path &path) const {
+        std::ofstream fout{path.native()};
+
+        if (!fout.is_open()) {
+            log_error("could not write metrics", "path", path.native());
+            return;
+        }
+
+        std::lock_guard lock{_mutex};
+
+        if (path.extension() != ".csv") {
+            _write_json(fout);
+            return;
+        }
+
+        _write_csv(fout);
+
+        auto run_path
+            = path.parent_path() / (path.stem().native() + ".run.csv");
+        std::ofstream run_fout{run_path.native()};
+
+        if (!run_fout.is_open()) {
+            log_error("could not write metrics", "path", run_path.native());
+            return;
+        }
+
+        _write_run_csv(run_fout);
+    }
+
+    /** first line of `<compiler> --version`, asked once per compiler */
+    std::string compiler_version(const test_target &target) {
+        {
+            std::lock_guard lock{_mutex};
+
+            if (auto found = _versions.find(target.compiler);
+                found != _versions.end()) {
+                return found->second;
+            }
+        }
+
+        auto output
+            = executable{target.compiler, {"--version"}, target.directory}
+                  .run();
+
+        auto version = output.exit_code == 0 && !output.stdout.empty()
+                           ? output.stdout.front()
+                           : "unknown";
+
+        std::lock_guard lock{_mutex};
+        _versions[target.compiler] = version;
+
+        return version;
+    }
+
+    /**
+     * FNV-1a of the compiler args - stable across runs and machines, unlike
+     * std::hash
+     */
+    static std::string flags_hash(const std::vector<std::string> &args) {
+        std::uint64_t hash = 0xcbf29ce484222325;
+
+        for (auto &arg : args) {
+            // the terminating '\0' too, so {"ab", "c"} != {"a", "bc"}
+            for (auto c : arg + '\0') {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 0x100000001b3;
+            }
+        }
+
+        return fmt::format("{:016x}", hash);
+    }
+
+private:
+    /** the run as a whole */
+    struct run_totals {
+        double wall_seconds;
+        double average_concurrency;
+        double discovery_seconds;
+        unsigned long compiler_invocations;
+        std::size_t cases;
+        long compiled_cases;
+        double pch_hit_rate;
+    };
+
+    std::size_t _jobs;
+    std::chrono::steady_clock::time_point _start
+        = std::chrono::steady_clock::now();
+    mutable std::mutex _mutex;
+    std::vector<source_metrics> _sources;
+    std::vector<case_metrics> _cases;
+    std::map<std::string, std::string> _versions;
+
+    static const char *_result_name(test_case_result result) {
+        switch (result) {
+            case test_case_result::pass:
+                return "pass";
+            case test_case_result::fail:
+                return "fail";
+            case test_case_result::error:
+                return "error";
+            case test_case_result::skipped:
+                return "skipped";
+        }
+
+        return "";
+    }
+
+    static std::string _csv_escape(const std::string &value) {
+        if (value.find_first_of(",\"\n") == std::string::npos) {
+            return value;
+        }
+
+        std::string escaped = "\"";
+
+        for (auto c : value) {
+            escaped += c == '"' ? "\"\"" : std::string(1, c);
+        }
+
+        return escaped + "\"";
+    }
+
+    const source_metrics *_source(const std::string &source) const {
+        for (auto &metrics : _sources) {
+            if (metrics.source == source) {
+                return &metrics;
+            }
+        }
+
+        return nullptr;
+    }
+
+    run_totals _totals() const {
+        auto wall = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - _start)
+                        .count();
+
+        auto discovery = 0.0;
+
+        for (auto &source : _sources) {
+            discovery += source.discovery.count() / 1e3;
+        }
+
+        auto compiled = 0L;
+        auto pch = 0L;
+        auto compile_seconds = 0.0;
+
+        for (auto &tc : _cases) {
+            compiled += tc.compiled;
+            pch += tc.pch;
+            compile_seconds += tc.wall.count() / 1e3;
+        }
+
+        return {
+            wall,
+            wall > 0 ? compile_seconds / wall : 0,
+            discovery,
+            compiler::invocations(),
+            _cases.size(),
+            compiled,
+            compiled > 0 ? static_cast<double>(pch) / compiled : 0,
+        };
+    }
+
+    void _write_run_csv(std::ofstream &fout) const {
+        auto totals = _totals();
+
+        fout << "wall_seconds,jobs,average_concurrency,discovery_seconds,"
+                "compiler_invocations,cases,compiled_cases,pch_hit_rate\n";
+
+        fout << fmt::format("{:.3f},{},{:.2f},{:.3f},{},{},{},{:.3f}\n",
+                            totals.wall_seconds,
+                            _jobs,
+                            totals.average_concurrency,
+                            totals.discovery_seconds,
+                            totals.compiler_invocations,
+                            totals.cases,
+                            totals.compiled_cases,
+                            totals.pch_hit_rate);
+    }
+
+    void _write_csv(std::ofstream &fout) const {
+        fout << "source,suite,case,object,verb,result,wall_ms,cpu_seconds,"
+                "peak_rss_kb,diagnostic_lines,pch,compiler_version,"
+                "flags_hash\n";
+
+        for (auto &tc : _cases) {
+            auto *source = _source(tc.source);
+
+            fout << fmt::format(
+                "{},{},{},{},{},{},{},{:.3f},{},{},{},{},{}\n",
+                _csv_escape(tc.source),
+                _csv_escape(tc.suite),
+                _csv_escape(tc.symbol),
+                _csv_escape(tc.object),
+                _csv_escape(tc.verb),
+                _result_name(tc.result),
+                tc.wall.count(),
+                tc.cpu_seconds,
+                tc.peak_rss_kb,
+                tc.diagnostic_lines,
+                tc.pch ? 1 : 0,
+                _csv_escape(source ? source->compiler_version : ""),
+                source ? source->flags_hash : "");
+        }
+    }
+
+    void _write_json(std::ofstream &fout) const {
+        auto totals = _totals();
+
+        fout << fmt::format(
+            R"({{
+  "run": {{
+    "wall_seconds": {:.3f},
+    "jobs": {},
+    "average_concurrency": {:.2f},
+    "discovery_seconds": {:.3f},
+    "compiler_invocations": {},
+    "cases": {},
+    "compiled_cases": {},
+    "pch_hit_rate": {:.3f}
+  }},
+  "sources": [)",
+            totals.wall_seconds,
+            _jobs,
+            totals.average_concurrency,
+            totals.discovery_seconds,
+            totals.compiler_invocations,
+            totals.cases,
+            totals.compiled_cases,
+            totals.pch_hit_rate);
+
+        auto first = true;
+
+        for (auto &source : _sources) {
+            fout << fmt::format(
+                R"({}
+    {{
+      "source": "{}",
+      "compiler": "{}",
+      "compiler_version": "{}",
+      "flags_hash": "{}",
+      "discovery_ms": {}
+    }})",
+                first ? "" : ",",
+                json_escape(source.source),
+                json_escape(source.compiler),
+                json_escape(source.compiler_version),
+                source.flags_hash,
+                source.discovery.count());
+
+            first = false;
+        }
+
+        fout << "\n  ],\n  \"cases\": [";
+
+        first = true;
+
+        for (auto &tc : _cases) {
+            fout << fmt::format(
+                R"({}
+    {{
+      "source": "{}",
+      "suite": "{}",
+      "case": "{}",
+      "object": "{}",
+      "verb": "{}",
+      "result": "{}",
+      "wall_ms": {},
+      "cpu_seconds": {:.3f},
+      "peak_rss_kb": {},
+      "diagnostic_lines": {},
+      "pch": {}
+    }})",
+                first ? "" : ",",
+                json_escape(tc.source),
+                json_escape(tc.suite),
+                json_escape(tc.symbol),
+                json_escape(tc.object),
+                json_escape(tc.verb),
+                _result_name(tc.result),
+                tc.wall.count(),
+                tc.cpu_seconds,
+                tc.peak_rss_kb,
+                tc.diagnostic_lines,
+                tc.pch);
+
+            first = false;
+        }
+
+        fout << "\n  ]\n}\n";
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "range/v3/all.hpp"
+
+#include "code.hh"
+#include "compiler.hh"
+#include "log.hh"
+#include "test_target.hh"
+#include "trace.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace rv = ranges::views;
+
+/**
+ * The source under test, parsed once into a precompiled header
+ *
+ * Without it, every case compiles the whole source plus a small main() that
+ * instantiates the case - so every case re-parses the source and all it
+ * includes.  With it, each case compiles only that main(), with the source
+ * force-included (-include) from the precompiled header, so a case pays for
+ * its own instantiations and little else.
+ *
+ * The header is written as <name>.hh.gch next to a copy of the source named
+ * <name>.hh - the name both gcc and clang look for when they see
+ * -include <name>.hh.  The copy is marked with the source's path, so
+ * diagnostics point into the source, as they do without a PCH.
+ */
+class precompiled_source {
+public:
+    precompiled_source(const test_target &target, bool time_trace) {
+        auto span = trace_span{"precompile source", "runner"};
+
+        auto dir = bfs::temp_directory_path() / bfs::unique_path();
+        bfs::create_directories(dir);
+
+        auto header = dir / "source.hh";
+        auto pch = dir / "source.hh.gch";
+
+        std::ofstream{header.native()} << code{target.source}.content();
+
+        auto args = copy_args(target.source, target.compiler_args);
+
+        std::vector<std::string> pch_args = {"-x", "c++-header"};
+        pch_args.insert(pch_args.end(), args.cbegin(), args.cend());
+
+        auto result
+            = compiler{target.compiler, pch_args, time_trace, target.directory}
+                  .compile(header, pch);
+
+        if (!result.compiled) {
+            log_warning(
+                "could not precompile the source, compiling each case in full",
+                "source",
+                target.source,
+                "diagnostics",
+                result.diagnostics
+                    | rv::transform(&compiler_diagnostic::original));
+            return;
+        }
+
+        log_debug("precompiled source", "pch", pch.native());
+
+        _case_args = args;
+        _case_args->push_back("-include");
+        _case_args->push_back(header.native());
+    }
+
+    /** whether the source was precompiled - if not, compile cases in full */
+    bool built() const { return _case_args.has_value(); }
+
+    /** compiler args for a case's main() when built() */
+    const std::vector<std::string> &case_args() const { return *_case_args; }
+
+private:
+    std::optional<std::vector<std::string>> _case_args;
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "trace.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/**
+ * Fixed set of worker threads, running tasks in the order they're submitted
+ *
+ * A task may wait on the future of a task submitted before it - that task
+ * has already been taken by a worker, so it can't deadlock.
+ */
+class worker_pool {
+public:
+    worker_pool(std::size_t workers) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(workers, 1); i++) {
+            _workers.emplace_back([this, i] {
+                tracer::instance().name_thread(fmt::format("worker {}", i));
+                _work();
+            });
+        }
+    }
+
+    worker_pool(const worker_pool &) = delete;
+    worker_pool &operator=(const worker_pool &) = delete;
+
+    ~worker_pool() {
+        {
+            std::lock_guard lock{_mutex};
+            _stopping = true;
+        }
+
+        _cv.notify_all();
+
+        for (auto &worker : _workers) {
+            worker.join();
+        }
+    }
+
+    template <typename F>
+    auto submit(F &&f) -> std::future<std::invoke_result_t<F>> {
+        using result = std::invoke_result_t<F>;
+
+        auto task = std::make_shared<std::packaged_task<result()>>(
+            std::forward<F>(f));
+
+        auto future = task->get_future();
+
+        {
+            std::lock_guard lock{_mutex};
+            _tasks.push([task] { (*task)(); });
+        }
+
+        _cv.notify_one();
+
+        return future;
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stopping = false;
+
+    void _work() {
+        while (true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock lock{_mutex};
+                _cv.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+
+                if (_tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop();
+            }
+
+            task();
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
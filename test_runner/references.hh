@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+
+#include "elf.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** a MUST_NOT_REFERENCE case's forbidden symbols, from its macro arguments */
+struct reference_spec {
+    std::vector<std::string> forbidden;
+
+    /**
+     * "<symbol>[, <symbol>...]", each quoted or not - commas in brackets
+     * don't split, so operator()(int, int) is one symbol.  Empty if there
+     * are none
+     */
+    static std::optional<reference_spec> parse(const std::string &args) {
+        reference_spec spec;
+        std::string symbol;
+        auto depth = 0;
+
+        auto add = [&] {
+            auto trimmed = std::regex_replace(
+                symbol, std::regex{R"(^\s*"?\s*|\s*"?\s*$)"}, "");
+
+            if (!trimmed.empty()) {
+                spec.forbidden.push_back(trimmed);
+            }
+
+            symbol.clear();
+        };
+
+        for (auto c : args) {
+            if (c == ',' && depth == 0) {
+                add();
+                continue;
+            }
+
+            depth += c == '(' || c == '<' || c == '[';
+            depth -= c == ')' || c == '>' || c == ']';
+            symbol += c;
+        }
+
+        add();
+
+        if (spec.forbidden.empty()) {
+            return {};
+        }
+
+        return spec;
+    }
+
+    /**
+     * the forbidden name a mangled symbol matches, if any - by its mangled
+     * name, its demangled name, or its demangled name less its parameters,
+     * so "operator new" is every operator new(...), but not operator new[]
+     */
+    std::optional<std::string> match(const std::string &symbol) const {
+        auto demangled = demangle(symbol);
+
+        for (auto &name : forbidden) {
+            if (symbol == name || demangled == name
+                || demangled.compare(0, name.size() + 1, name + "(") == 0) {
+                return name;
+            }
+        }
+
+        return {};
+    }
+};
+
+/** a forbidden symbol the case's code refers to */
+struct forbidden_reference {
+    std::string symbol;
+    // relocations against it, past those of the source alone
+    unsigned long count;
+};
+
+/** what a MUST_NOT_REFERENCE case's code refers to, of what it mustn't */
+struct reference_result {
+    reference_spec spec;
+    std::vector<forbidden_reference> found = {};
+    // why the object couldn't be read
+    std::optional<std::string> unmeasured = {};
+
+    /** the case's object against one of the source alone */
+    static reference_result of(const reference_spec &spec,
+                               const elf_object &with_case,
+                               const elf_object &alone) {
+        auto result = reference_result{spec};
+
+        for (auto &[symbol, count] : with_case.references) {
+            auto before = alone.references.find(symbol);
+            auto added = before == alone.references.end()
+                             ? count
+                             : count - std::min(count, before->second);
+
+            if (added > 0 && spec.match(symbol)) {
+                result.found.push_back({demangle(symbol), added});
+            }
+        }
+
+        return result;
+    }
+
+    bool clean() const { return !unmeasured && found.empty(); }
+
+    std::string to_string() const {
+        std::vector<std::string> references;
+
+        for (auto &reference : found) {
+            references.push_back(
+                fmt::format("{} ({}x)", reference.symbol, reference.count));
+        }
+
+        return fmt::format("[{}] of forbidden [{}]",
+                           fmt::join(references, ", "),
+                           fmt::join(spec.forbidden, ", "));
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+
+#include "compiler.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** what MUST_VECTORIZE and MUST_INLINE cases ask the optimizer for */
+enum class optimization {
+    vectorize,
+    inline_call,
+};
+
+/**
+ * Flags reporting where optimization was applied and missed, as remarks in
+ * the diagnostics - clang's -Rpass, gcc's -fopt-info
+ */
+inline std::vector<std::string> remark_args(optimization wanted, bool clang) {
+    auto vectorize = wanted == optimization::vectorize;
+
+    if (clang) {
+        auto pass = vectorize ? "loop-vectorize" : "inline";
+
+        return {fmt::format("-Rpass={}", pass),
+                fmt::format("-Rpass-missed={}", pass)};
+    }
+
+    return {vectorize ? "-fopt-info-vec-optimized-missed"
+                      : "-fopt-info-inline-optimized-missed"};
+}
+
+/** one remark - optimization applied or missed at a place in the source */
+struct optimization_remark {
+    optimization kind;
+    bool applied;
+
+    /** empty if diag isn't a vectorize or inline remark */
+    static std::optional<optimization_remark>
+    from(const compiler_diagnostic &diag) {
+        // clang first, then gcc
+        const static std::regex vectorized{
+            R"(vectorized loop|loop vectorized)"};
+        const static std::regex not_vectorized{
+            R"(loop not vectorized|couldn't vectorize loop)"};
+        const static std::regex inlined{
+            R"(' inlined into '|^\s*Inlin(ing|ed) .+ into )"};
+        const static std::regex not_inlined{
+            R"(' not inlined into '|will not be inlined|not inlinable|)"
+            R"(will not (early )?inline)"};
+        // a call to a function only declared here can't be inlined, and
+        // isn't the case's to fix - operator new, ex
+        const static std::regex no_definition{
+            R"(definition is unavailable|body not available)"};
+
+        if (diag.sev != severity::remark) {
+            return {};
+        }
+
+        auto &m = diag.message;
+
+        if (std::regex_search(m, vectorized)) {
+            return optimization_remark{optimization::vectorize, true};
+        }
+
+        if (std::regex_search(m, not_vectorized)) {
+            return optimization_remark{optimization::vectorize, false};
+        }
+
+        if (std::regex_search(m, inlined)) {
+            return optimization_remark{optimization::inline_call, true};
+        }
+
+        if (std::regex_search(m, not_inlined)
+            && !std::regex_search(m, no_definition)) {
+            return optimization_remark{optimization::inline_call, false};
+        }
+
+        return {};
+    }
+};
+
+/**
+ * Whether a MUST_VECTORIZE or MUST_INLINE case's lines got the optimization
+ *
+ * Remarks are grouped by line and column - a loop or a call site.  The
+ * compiler may miss a place in one pass and optimize it in a later one, so
+ * a place counts as optimized if any remark there says so.
+ */
+struct optimization_result {
+    optimization wanted;
+    // line:column of each place optimized
+    std::vector<std::string> applied = {};
+    // line:column and the compiler's reason, for each place never optimized
+    std::vector<std::string> missed = {};
+    // why remarks couldn't be asked for
+    std::optional<std::string> unmeasured = {};
+
+    /** on_case: whether a diagnostic is on one of the case's lines */
+    static optimization_result
+    of(optimization wanted,
+       const std::vector<compiler_diagnostic> &diagnostics,
+       const std::function<bool(const compiler_diagnostic &)> &on_case) {
+        struct place {
+            bool applied = false;
+            std::string reason;
+        };
+
+        std::map<std::pair<unsigned long, unsigned long>, place> places;
+
+        for (auto &diag : diagnostics) {
+            auto remark = optimization_remark::from(diag);
+
+            if (!remark || remark->kind != wanted || !on_case(diag)) {
+                continue;
+            }
+
+            auto &p = places[{diag.line, diag.column}];
+            p.applied = p.applied || remark->applied;
+
+            if (!remark->applied && p.reason.empty()) {
+                p.reason = std::regex_replace(
+                    diag.message, std::regex{R"(^\s+|\s+$)"}, "");
+            }
+        }
+
+        auto result = optimization_result{wanted};
+
+        for (auto &[where, p] : places) {
+            auto location = fmt::format("{}:{}", where.first, where.second);
+
+            if (p.applied) {
+                result.applied.push_back(location);
+            } else {
+                result.missed.push_back(
+                    fmt::format("{} - {}", location, p.reason));
+            }
+        }
+
+        return result;
+    }
+
+    bool achieved() const {
+        return !unmeasured && !applied.empty() && missed.empty();
+    }
+
+    std::string to_string() const {
+        auto what = wanted == optimization::vectorize ? "loops vectorized"
+                                                      : "calls inlined";
+
+        if (applied.empty() && missed.empty()) {
+            return fmt::format("no {} or missed on the case's lines - is "
+                               "there a loop or call in its body?",
+                               what);
+        }
+
+        return fmt::format("{} at [{}], missed at [{}]",
+                           what,
+                           fmt::join(applied, ", "),
+                           fmt::join(missed, "; "));
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
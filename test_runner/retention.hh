@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "spill.hh"
+#include "test_case_run.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** how much of a finished case's compiler output to keep until it's written */
+struct retention_policy {
+    // most output to keep in memory for a failing case, 0 for no limit
+    std::size_t max_output_bytes = 0;
+    // spill output over max_output_bytes to disk, rather than dropping it
+    bool spill = false;
+};
+
+/**
+ * Drop what a finished case no longer needs before it waits to be written
+ *
+ * Results only need the static_assert diagnostics, and JUnit only writes
+ * compiler output for failing cases.  Failing output over the limit is
+ * spilled or cut short.
+ */
+inline void retain(testcase_run &run, const retention_policy &policy) {
+    if (!run.compiler_output) {
+        return;
+    }
+
+    auto &result = *run.compiler_output;
+
+    result.diagnostics.erase(
+        std::remove_if(result.diagnostics.begin(),
+                       result.diagnostics.end(),
+                       [](auto &diag) { return !diag.static_assert_msg; }),
+        result.diagnostics.end());
+    result.diagnostics.shrink_to_fit();
+
+    auto &out = result.compile_output;
+
+    if (run.result() == test_case_result::pass) {
+        out.stdout = {};
+        out.stderr = {};
+        return;
+    }
+
+    auto bytes = [](const std::vector<std::string> &lines) {
+        return std::accumulate(
+            lines.begin(), lines.end(), 0UL, [](auto total, auto &line) {
+                return total + line.size() + 1;
+            });
+    };
+
+    auto total = bytes(out.stdout) + bytes(out.stderr);
+
+    if (policy.max_output_bytes == 0 || total <= policy.max_output_bytes) {
+        return;
+    }
+
+    if (policy.spill) {
+        result.spilled
+            = std::make_shared<spilled_output>(out.stdout, out.stderr);
+        out.stdout = {};
+        out.stderr = {};
+        return;
+    }
+
+    // the start of stderr first - that's where the diagnostics are - then
+    // stdout with what's left
+    auto budget = policy.max_output_bytes;
+    auto dropped = 0UL;
+
+    for (auto *lines : {&out.stderr, &out.stdout}) {
+        std::size_t keep = 0;
+
+        while (keep < lines->size() && (*lines)[keep].size() + 1 <= budget) {
+            budget -= (*lines)[keep].size() + 1;
+            keep++;
+        }
+
+        if (keep < lines->size()) {
+            dropped += lines->size() - keep;
+            budget = 0;
+        }
+
+        lines->resize(keep);
+        lines->shrink_to_fit();
+    }
+
+    out.stderr.push_back(fmt::format(
+        "... {} more lines of compiler output dropped - see --output-limit",
+        dropped));
+}
+
+} // namespace dhagedorn::comp_test::impl
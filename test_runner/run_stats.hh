@@ -0,0 +1,84 @@
+#pragma once
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/core.h"
+#include "range/v3/all.hpp"
+
+#include "compiler.hh"
+#include "log.hh"
+#include "test_suite_run.hh"
+#include "util.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace r = ranges;
+namespace rv = ranges::views;
+
+/**
+ * Cost of the runner itself for a whole run, written as JSON so runs can be
+ * compared across commits
+ */
+struct run_stats {
+    std::string source;
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    void write(const bfs::path &path,
+               const std::vector<test_suite_run> &suite_runs) const {
+        auto wall = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+        rusage self{};
+        getrusage(RUSAGE_SELF, &self);
+
+        auto sum = [&](auto count) {
+            return r::accumulate(suite_runs | rv::transform(count), 0L);
+        };
+
+        std::ofstream fout{path.native()};
+
+        if (!fout.is_open()) {
+            log_error("could not write run stats", "path", path.native());
+            return;
+        }
+
+        fout << fmt::format(
+            R"({{
+  "source": "{}",
+  "cases": {},
+  "passed": {},
+  "failed": {},
+  "errors": {},
+  "wall_seconds": {:.3f},
+  "compiler_invocations": {},
+  "runner_cpu_seconds": {:.3f},
+  "runner_peak_rss_kb": {}
+}}
+)",
+            json_escape(source),
+            sum([](auto &run) { return static_cast<long>(run.tests()); }),
+            sum([](auto &run) { return static_cast<long>(run.passed()); }),
+            sum([](auto &run) { return static_cast<long>(run.failed()); }),
+            sum([](auto &run) { return static_cast<long>(run.errors()); }),
+            wall,
+            compiler::invocations(),
+            _seconds(self.ru_utime) + _seconds(self.ru_stime),
+            self.ru_maxrss);
+    }
+
+private:
+    static double _seconds(const timeval &tv) {
+        return tv.tv_sec + tv.tv_usec / 1e6;
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
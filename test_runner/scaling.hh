@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/ranges.h"
+
+#include "util.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+/** growth classes a COMP_SCALING case's compile time is fitted to */
+enum class complexity {
+    constant,
+    logarithmic,
+    linear,
+    linearithmic,
+    quadratic,
+    cubic,
+};
+
+inline const std::vector<complexity> &complexities() {
+    const static std::vector<complexity> all{
+        complexity::constant,
+        complexity::logarithmic,
+        complexity::linear,
+        complexity::linearithmic,
+        complexity::quadratic,
+        complexity::cubic,
+    };
+
+    return all;
+}
+
+/** the f in O(f) */
+inline std::string growth_name(complexity c) {
+    switch (c) {
+        case complexity::constant:
+            return "1";
+        case complexity::logarithmic:
+            return "log N";
+        case complexity::linear:
+            return "N";
+        case complexity::linearithmic:
+            return "N log N";
+        case complexity::quadratic:
+            return "N^2";
+        case complexity::cubic:
+            return "N^3";
+    }
+
+    return "";
+}
+
+inline std::string to_string(complexity c) {
+    return fmt::format("O({})", growth_name(c));
+}
+
+/** f(N) of a class - compile time is fitted as a + b * f(N) */
+inline double growth(complexity c, double n) {
+    switch (c) {
+        case complexity::constant:
+            return 0;
+        case complexity::logarithmic:
+            return std::log2(n);
+        case complexity::linear:
+            return n;
+        case complexity::linearithmic:
+            return n * std::log2(n);
+        case complexity::quadratic:
+            return n * n;
+        case complexity::cubic:
+            return n * n * n;
+    }
+
+    return 0;
+}
+
+/** a COMP_SCALING case's bound and sizes, from its macro arguments */
+struct scaling_spec {
+    complexity bound;
+    std::vector<unsigned long> sizes;
+
+    /** "<bound>[, <size>...]" - empty if it doesn't parse */
+    static std::optional<scaling_spec> parse(const std::string &args) {
+        const static std::regex item{R"(\s*([^,\s]+)\s*(,|$))"};
+        const static std::vector<std::string> names{
+            "constant",
+            "logarithmic",
+            "linear",
+            "linearithmic",
+            "quadratic",
+            "cubic",
+        };
+
+        std::vector<std::string> items;
+
+        for (auto it = std::sregex_iterator{args.begin(), args.end(), item};
+             it != std::sregex_iterator{};
+             it++) {
+            items.push_back((*it)[1]);
+        }
+
+        if (items.empty()) {
+            return {};
+        }
+
+        auto name = std::find(names.begin(), names.end(), items.front());
+
+        if (name == names.end()) {
+            return {};
+        }
+
+        auto spec = scaling_spec{complexities()[name - names.begin()]};
+
+        for (std::size_t i = 1; i < items.size(); i++) {
+            auto size = parse_count(items[i]);
+
+            if (!size) {
+                return {};
+            }
+
+            spec.sizes.push_back(*size);
+        }
+
+        if (spec.sizes.empty()) {
+            spec.sizes = {16, 64, 256, 1024};
+        }
+
+        std::sort(spec.sizes.begin(), spec.sizes.end());
+        spec.sizes.erase(std::unique(spec.sizes.begin(), spec.sizes.end()),
+                         spec.sizes.end());
+
+        // 3 points at least to tell one curve from another
+        if (spec.sizes.size() < 3 || spec.sizes.front() == 0) {
+            return {};
+        }
+
+        return spec;
+    }
+};
+
+/** compile time at one size */
+struct scaling_point {
+    unsigned long size;
+    double cpu_ms;
+};
+
+/**
+ * The simplest growth class that fits a case's compile time curve
+ *
+ * Each class is fitted as a + b * f(N) by least squares, a being the cost of
+ * everything but the case - parsing the source, starting the compiler.  The
+ * best fit wins, unless a simpler class fits nearly as well: within half
+ * again of its squared error, plus 2% of the mean time per point for noise.
+ * So a curve too flat to tell from noise fits the simpler class.
+ */
+struct scaling_fit {
+    std::vector<scaling_point> curve;
+    complexity fitted;
+    double overhead_ms;
+    double per_unit_ms;
+
+    static scaling_fit of(std::vector<scaling_point> curve) {
+        struct candidate {
+            complexity c;
+            double a;
+            double b;
+            double error;
+        };
+
+        auto n = static_cast<double>(curve.size());
+        double mean_t = 0;
+
+        for (auto &point : curve) {
+            mean_t += point.cpu_ms / n;
+        }
+
+        std::vector<candidate> candidates;
+
+        for (auto c : complexities()) {
+            double mean_f = 0;
+
+            for (auto &point : curve) {
+                mean_f += growth(c, point.size) / n;
+            }
+
+            double covariance = 0;
+            double variance = 0;
+
+            for (auto &point : curve) {
+                auto df = growth(c, point.size) - mean_f;
+                covariance += df * (point.cpu_ms - mean_t);
+                variance += df * df;
+            }
+
+            // a class the curve shrinks along fits no better than constant
+            auto b = variance > 0 ? std::max(covariance / variance, 0.0) : 0;
+            auto a = mean_t - b * mean_f;
+
+            double error = 0;
+
+            for (auto &point : curve) {
+                auto residual
+                    = point.cpu_ms - (a + b * growth(c, point.size));
+                error += residual * residual;
+            }
+
+            candidates.push_back({c, a, b, error});
+        }
+
+        auto best = std::min_element(
+            candidates.begin(),
+            candidates.end(),
+            [](auto &l, auto &r) { return l.error < r.error; });
+
+        auto noise = n * std::pow(0.02 * mean_t, 2);
+
+        // simplest first
+        auto fitted = std::find_if(
+            candidates.begin(), candidates.end(), [&](auto &candidate) {
+                return candidate.error <= 1.5 * best->error + noise;
+            });
+
+        return {std::move(curve), fitted->c, fitted->a, fitted->b};
+    }
+
+    std::string to_string() const {
+        std::vector<std::string> points;
+
+        for (auto &point : curve) {
+            points.push_back(
+                fmt::format("N={}: {:.1f} ms", point.size, point.cpu_ms));
+        }
+
+        auto fit = fitted == complexity::constant
+                       ? fmt::format("{:.1f} ms", overhead_ms)
+                       : fmt::format("{:.1f} ms + {:.3g} ms * {}",
+                                     overhead_ms,
+                                     per_unit_ms,
+                                     growth_name(fitted));
+
+        return fmt::format("{}, fitted as {} - {}",
+                           impl::to_string(fitted),
+                           fit,
+                           fmt::join(points, ", "));
+    }
+};
+
+/** a COMP_SCALING case's fitted curve, against its bound */
+struct scaling_result {
+    complexity bound;
+    scaling_fit fit;
+
+    bool within_bound() const { return fit.fitted <= bound; }
+};
+
+} // namespace dhagedorn::comp_test::impl
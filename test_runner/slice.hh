@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cctype>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/**
+ * Just enough of a C++ lexer to find the brackets in a source - skips
+ * comments, string and character literals, and preprocessor lines
+ */
+class bracket_scanner {
+public:
+    bracket_scanner(const std::string &text)
+        : _text{text} {}
+
+    std::size_t pos() const { return _pos; }
+    unsigned long line() const { return _line; }
+    bool done() const { return _pos >= _text.size(); }
+
+    /** move to the next character that's code, past anything skipped */
+    void skip() {
+        while (!done()) {
+            auto c = _text[_pos];
+
+            if (c == '\n') {
+                _line++;
+                _pos++;
+                _line_start = true;
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                _pos++;
+            } else if (c == '#' && _line_start) {
+                _skip_directive();
+            } else if (_starts("//")) {
+                _skip_to_newline();
+            } else if (_starts("/*")) {
+                _skip_past("*/", 2);
+            } else if (c == 'R' && _pos + 1 < _text.size()
+                       && _text[_pos + 1] == '"' && !_in_identifier()) {
+                _skip_raw_string();
+            } else if (c == '"' || (c == '\'' && !_in_identifier())) {
+                _skip_quoted(c);
+            } else {
+                return;
+            }
+        }
+    }
+
+    /** the identifier at pos(), and move past it - empty if there isn't one */
+    std::string identifier() {
+        std::string ident;
+
+        while (!done() && _identifier_char(_text[_pos])) {
+            ident += _text[_pos++];
+        }
+
+        if (ident.empty()) {
+            _pos++;
+        }
+
+        _line_start = false;
+
+        return ident;
+    }
+
+    /**
+     * At an opening bracket, move past its matching close and return the
+     * close's position - npos if it's unmatched
+     */
+    std::size_t match(char open, char close) {
+        auto depth = 0;
+
+        while (!done()) {
+            skip();
+
+            if (done()) {
+                break;
+            }
+
+            auto c = _text[_pos];
+
+            if (c == open) {
+                depth++;
+            } else if (c == close && --depth == 0) {
+                return _pos++;
+            }
+
+            _pos++;
+            _line_start = false;
+        }
+
+        return std::string::npos;
+    }
+
+private:
+    const std::string &_text;
+    std::size_t _pos = 0;
+    unsigned long _line = 1;
+    bool _line_start = true;
+
+    static bool _identifier_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // ' after a digit is a digit separator, and R" ends an identifier
+    bool _in_identifier() const {
+        return _pos > 0 && _identifier_char(_text[_pos - 1]);
+    }
+
+    bool _starts(const char *prefix) const {
+        auto size = std::char_traits<char>::length(prefix);
+        return _text.compare(_pos, size, prefix) == 0;
+    }
+
+    void _advance_to(std::size_t end) {
+        for (; _pos < end && _pos < _text.size(); _pos++) {
+            if (_text[_pos] == '\n') {
+                _line++;
+            }
+        }
+    }
+
+    void _skip_past(const std::string &end, std::size_t from) {
+        auto found = _text.find(end, _pos + from);
+
+        _advance_to(found == std::string::npos ? _text.size()
+                                               : found + end.size());
+    }
+
+    void _skip_to_newline() {
+        auto found = _text.find('\n', _pos);
+        _advance_to(found == std::string::npos ? _text.size() : found);
+    }
+
+    void _skip_directive() {
+        while (!done() && _text[_pos] != '\n') {
+            if (_text[_pos] == '\\' && _pos + 1 < _text.size()
+                && _text[_pos + 1] == '\n') {
+                _advance_to(_pos + 2);
+            } else if (_starts("/*")) {
+                _skip_past("*/", 2);
+            } else {
+                _pos++;
+            }
+        }
+    }
+
+    void _skip_quoted(char quote) {
+        _pos++;
+
+        while (!done() && _text[_pos] != quote && _text[_pos] != '\n') {
+            _advance_to(_pos + (_text[_pos] == '\\' ? 2 : 1));
+        }
+
+        _pos++;
+        _line_start = false;
+    }
+
+    void _skip_raw_string() {
+        auto open = _text.find('(', _pos);
+
+        if (open == std::string::npos) {
+            _pos = _text.size();
+            return;
+        }
+
+        auto delim = _text.substr(_pos + 2, open - _pos - 2);
+        _skip_past(")" + delim + "\"", open - _pos);
+        _line_start = false;
+    }
+};
+
+/**
+ * The source under test, with the bodies of all but one case blanked out
+ *
+ * Every case compile otherwise parses the body of every case in the source,
+ * though it instantiates only one.  Bodies of cases compiled by the runner -
+ * MUST_STATIC_ASSERT, MUST_COMPILE, MUST_VECTORIZE, MUST_INLINE,
+ * MUST_NOT_REFERENCE and the COMP_ macros - are found by scanning for the
+ * macros, and blanked with spaces - newlines are kept, so line numbers, and
+ * the symbols made from them, don't change.  Suites, registrations, and
+ * everything outside a case body stay as they are.
+ *
+ * Cases declared through other macros aren't found, and are left whole.
+ */
+class sliced_source {
+public:
+    sliced_source(const std::string &path) {
+        std::ifstream fin{path};
+        std::stringstream content;
+        content << fin.rdbuf();
+
+        _original = content.str();
+        _find_bodies();
+
+        _blanked = _original;
+
+        for (auto &body : _bodies) {
+            _blank(_blanked, body);
+        }
+
+        log_debug(
+            "sliced source", "source", path, "case bodies", _bodies.size());
+    }
+
+    /** the source with only the bodies of the cases declared on lines kept */
+    std::string for_cases(const std::vector<unsigned long> &lines) const {
+        auto text = _blanked;
+
+        for (auto &body : _bodies) {
+            for (auto line : lines) {
+                if (body.first_line <= line && line <= body.last_line) {
+                    text.replace(body.begin,
+                                 body.end - body.begin,
+                                 _original,
+                                 body.begin,
+                                 body.end - body.begin);
+                }
+            }
+        }
+
+        return text;
+    }
+
+    /**
+     * first and last line of the body of the case declared on line - empty
+     * if no case found is declared there
+     */
+    std::optional<std::pair<unsigned long, unsigned long>>
+    body_lines(unsigned long line) const {
+        for (auto &body : _bodies) {
+            if (body.first_line <= line && line <= body.last_line) {
+                return std::make_pair(body.open_line, body.close_line);
+            }
+        }
+
+        return {};
+    }
+
+private:
+    struct case_body {
+        // lines of the macro invocation - __LINE__ is one of them
+        unsigned long first_line;
+        unsigned long last_line;
+        // between the braces
+        std::size_t begin;
+        std::size_t end;
+        // lines of the braces
+        unsigned long open_line;
+        unsigned long close_line;
+    };
+
+    std::string _original;
+    std::string _blanked;
+    std::vector<case_body> _bodies;
+
+    void _find_bodies() {
+        auto scan = bracket_scanner{_original};
+
+        while (!scan.done()) {
+            scan.skip();
+
+            auto first_line = scan.line();
+            auto name = scan.identifier();
+
+            if (name != "MUST_STATIC_ASSERT" && name != "MUST_COMPILE"
+                && name != "MUST_VECTORIZE" && name != "MUST_INLINE"
+                && name != "MUST_NOT_REFERENCE"
+                && name != "COMP_SCALING" && name != "COMP_BUDGET"
+                && name != "COMP_CODE_SIZE") {
+                continue;
+            }
+
+            scan.skip();
+
+            if (scan.done() || _original[scan.pos()] != '(') {
+                continue;
+            }
+
+            if (scan.match('(', ')') == std::string::npos) {
+                return;
+            }
+
+            auto last_line = scan.line();
+
+            scan.skip();
+
+            if (scan.done() || _original[scan.pos()] != '{') {
+                continue;
+            }
+
+            auto begin = scan.pos() + 1;
+            auto open_line = scan.line();
+            auto end = scan.match('{', '}');
+
+            if (end == std::string::npos) {
+                return;
+            }
+
+            _bodies.push_back(
+                {first_line, last_line, begin, end, open_line, scan.line()});
+        }
+    }
+
+    static void _blank(std::string &text, const case_body &body) {
+        for (auto i = body.begin; i < body.end; i++) {
+            if (text[i] != '\n') {
+                text[i] = ' ';
+            }
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "boost/filesystem/fstream.hpp"
+#include "boost/iostreams/filter/gzip.hpp"
+#include "boost/iostreams/filtering_stream.hpp"
+
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace bio = boost::iostreams;
+
+/**
+ * A case's compiler output, moved out of memory into gzip'd temp files
+ *
+ * The files are removed with the last reference - hold it in a shared_ptr
+ */
+class spilled_output {
+public:
+    spilled_output(const std::vector<std::string> &out,
+                   const std::vector<std::string> &err)
+        : _out{_temp_path()}
+        , _err{_temp_path()} {
+        _write(_out, out);
+        _write(_err, err);
+    }
+
+    spilled_output(const spilled_output &) = delete;
+    spilled_output &operator=(const spilled_output &) = delete;
+
+    ~spilled_output() {
+        boost::system::error_code ignored;
+        bfs::remove(_out, ignored);
+        bfs::remove(_err, ignored);
+    }
+
+    const bfs::path &out() const { return _out; }
+    const bfs::path &err() const { return _err; }
+
+    /** call f with each line of a spilled file, decompressing as it goes */
+    template <typename F>
+    static void for_each_line(const bfs::path &path, F &&f) {
+        bfs::ifstream fin{path, std::ios::binary};
+
+        bio::filtering_istream in;
+        in.push(bio::gzip_decompressor{});
+        in.push(fin);
+
+        for (std::string line; std::getline(in, line);) {
+            f(line);
+        }
+    }
+
+private:
+    bfs::path _out;
+    bfs::path _err;
+
+    static bfs::path _temp_path() {
+        return bfs::temp_directory_path()
+               / bfs::unique_path().replace_extension(".txt.gz");
+    }
+
+    static void _write(const bfs::path &path,
+                       const std::vector<std::string> &lines) {
+        bfs::ofstream fout{path, std::ios::binary};
+
+        if (!fout.is_open()) {
+            log_error("could not spill compiler output", "path", path.native());
+            return;
+        }
+
+        bio::filtering_ostream out;
+        out.push(bio::gzip_compressor{});
+        out.push(fout);
+
+        for (auto &line : lines) {
+            out << line << '\n';
+        }
+    }
+};
+
+} // namespace dhagedorn::comp_test::impl
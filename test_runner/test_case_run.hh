@@ -8,8 +8,14 @@
 #include "range/v3/all.hpp"
 #include "tinyxml2.h"
 
-#include "comp_test/comp_test.hh"
+#include "comp_test/comp_test_info.hh"
+#include "budget.hh"
+#include "code_size.hh"
 #include "compiler.hh"
+#include "hotspots.hh"
+#include "references.hh"
+#include "remarks.hh"
+#include "scaling.hh"
 #include "util.hh"
 
 namespace dhagedorn::comp_test::impl {
@@ -30,12 +36,61 @@ enum class test_case_result {
     skipped,
 };
 
+/** what one compile of a case cost */
+struct compile_sample {
+    double cpu_ms;
+    long peak_rss_kb;
+};
+
 struct testcase_run {
     comp_test::test_case tc;
     std::optional<compile_result> compiler_output;
     std::chrono::milliseconds duration;
+    // slowest template instantiations, if --hotspots was given
+    std::vector<template_hotspot> hotspots = {};
+    // each compile of the case, --repeat times
+    std::vector<compile_sample> samples = {};
+    // how it compiled slower than --baseline, if that fails it
+    std::optional<std::string> regression = {};
+    // COMP_SCALING only - its compile time curve, if it compiled at each size
+    std::optional<scaling_result> scaling = {};
+    // COMP_BUDGET only - its counts, if it compiled
+    std::optional<budget_result> budget = {};
+    // COMP_CODE_SIZE only - the code it emitted, if it compiled
+    std::optional<code_size_result> code_size = {};
+    // MUST_VECTORIZE/MUST_INLINE only - the remarks on its lines, if it
+    // compiled
+    std::optional<optimization_result> optimization = {};
+    // MUST_NOT_REFERENCE only - the forbidden symbols its code refers to, if
+    // it compiled
+    std::optional<reference_result> references = {};
 
     auto result() const {
+        auto result = _expected_result();
+
+        return result == test_case_result::pass && regression
+                   ? test_case_result::fail
+                   : result;
+    }
+
+    std::optional<std::string> fail_or_error_message() const {
+        if (regression && _expected_result() == test_case_result::pass) {
+            return fmt::format("compile regressed against the baseline: {}",
+                               *regression);
+        }
+
+        return _expectation_message();
+    }
+
+private:
+    test_case_result _expected_result() const {
+        if (tc.decided()) {
+            return tc.well_formed
+                           == (tc.type == comp_test::test_type::MUST_BE_VALID)
+                       ? test_case_result::pass
+                       : test_case_result::fail;
+        }
+
         if (!compiler_output) {
             return test_case_result::skipped; // TODO
         }
@@ -56,10 +111,33 @@ struct testcase_run {
                             compiler_output->compiled,
                             test_case_result::fail,
                             test_case_result::error);
+            case comp_test::test_type::COMP_SCALING:
+                return _measured_result(scaling.has_value(),
+                                        scaling && scaling->within_bound());
+            case comp_test::test_type::COMP_BUDGET:
+                return _measured_result(budget.has_value(),
+                                        budget && budget->within_budget(),
+                                        budget && budget->unmeasured);
+            case comp_test::test_type::MUST_VECTORIZE:
+            case comp_test::test_type::MUST_INLINE:
+                return _measured_result(
+                    optimization.has_value(),
+                    optimization && optimization->achieved(),
+                    optimization && optimization->unmeasured);
+            case comp_test::test_type::MUST_NOT_REFERENCE:
+                return _measured_result(references.has_value(),
+                                        references && references->clean(),
+                                        references && references->unmeasured);
+            case comp_test::test_type::COMP_CODE_SIZE:
+                return _measured_result(code_size.has_value(),
+                                        code_size && code_size->within_budget(),
+                                        code_size && code_size->unmeasured);
+            default:
+                return test_case_result::skipped;
         }
     }
 
-    std::optional<std::string> fail_or_error_message() const {
+    std::optional<std::string> _expectation_message() const {
         switch (tc.type) {
             case comp_test::test_type::MUST_COMPILE:
                 return when<std ::string>(
@@ -85,10 +163,116 @@ struct testcase_run {
                     fmt::format(
                         R"(case must static_assert with "{}", but failed to compile and raised no static_assert)",
                         tc.expected_assert_message));
+            case comp_test::test_type::COMP_SCALING:
+                return _measured_message(
+                    scaling,
+                    [](auto &measured) {
+                        return fmt::format("compile time must grow no faster "
+                                           "than {}, but grows as {}",
+                                           to_string(measured.bound),
+                                           measured.fit.to_string());
+                    },
+                    "compiled at every size");
+            case comp_test::test_type::COMP_BUDGET:
+                return _measured_message(budget, [](auto &measured) {
+                    return measured.unmeasured
+                               ? fmt::format(
+                                   "could not count the case's cost - {}",
+                                   *measured.unmeasured)
+                               : fmt::format("compile cost must stay within "
+                                             "budget, but was {}",
+                                             measured.to_string());
+                });
+            case comp_test::test_type::MUST_VECTORIZE:
+            case comp_test::test_type::MUST_INLINE:
+                return _measured_message(optimization, [](auto &measured) {
+                    return measured.unmeasured
+                               ? fmt::format(
+                                   "could not check the case's remarks - {}",
+                                   *measured.unmeasured)
+                               : fmt::format("case should have been "
+                                             "optimized, but {}",
+                                             measured.to_string());
+                });
+            case comp_test::test_type::MUST_NOT_REFERENCE:
+                return _measured_message(references, [](auto &measured) {
+                    return measured.unmeasured
+                               ? fmt::format(
+                                   "could not read the case's references - {}",
+                                   *measured.unmeasured)
+                               : fmt::format("code must not refer to "
+                                             "forbidden symbols, but refers "
+                                             "to {}",
+                                             measured.to_string());
+                });
+            case comp_test::test_type::COMP_CODE_SIZE:
+                return _measured_message(code_size, [](auto &measured) {
+                    return measured.unmeasured
+                               ? fmt::format(
+                                   "could not measure the case's code - {}",
+                                   *measured.unmeasured)
+                               : fmt::format("code must stay within budget, "
+                                             "but was {}",
+                                             measured.to_string());
+                });
+            case comp_test::test_type::MUST_BE_VALID:
+                return when<std::string>(
+                    tc.well_formed,
+                    {},
+                    "expression must be well-formed, but is not - move it into "
+                    "a MUST_COMPILE case to see the compiler's diagnostics");
+            case comp_test::test_type::MUST_BE_INVALID:
+                return when<std::string>(
+                    !tc.well_formed,
+                    {},
+                    "expression must be ill-formed, but is well-formed");
             default:
                 return "";
         }
     };
+
+    /**
+     * a case measured once it compiled - ex COMP_BUDGET's counts: it passes
+     * if measured within its limits, and fails if measured outside them, or
+     * if it asserted
+     * measured: the case compiled, and a measurement was taken
+     * ok: the measurement is within the case's limits
+     * unmeasured: the case compiled, but couldn't be measured
+     */
+    test_case_result
+    _measured_result(bool measured, bool ok, bool unmeasured = false) const {
+        return when(compiler_output->compiled && measured && ok,
+                    test_case_result::pass,
+                    compiler_output->compiled && measured && !unmeasured,
+                    test_case_result::fail,
+                    compiler_output->did_static_assert(),
+                    test_case_result::fail,
+                    test_case_result::error);
+    }
+
+    /**
+     * the message for a case measured once it compiled
+     * failure: why the measurement fails the case, or why it couldn't be made
+     * should: what the case should have done to be measured
+     */
+    template <typename MEASUREMENT, typename FAILURE>
+    std::string _measured_message(const std::optional<MEASUREMENT> &measured,
+                                  FAILURE failure,
+                                  const std::string &should
+                                  = "compiled") const {
+        if (compiler_output->compiled && measured) {
+            return failure(*measured);
+        }
+
+        if (compiler_output->did_static_assert()) {
+            return fmt::format(R"(case should have {}, but asserted with "{}")",
+                               should,
+                               *compiler_output->static_assert_msg());
+        }
+
+        return fmt::format(
+            "case should have {}, but failed to - see stdout/stderr", should);
+    }
 };
 
 } // namespace dhagedorn::comp_test::impl
\ No newline at end of file
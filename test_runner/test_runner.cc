@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <chrono>
 #include <stdio.h>
 
@@ -15,15 +16,35 @@
 #include "fmt/ranges.h"
 #include "range/v3/all.hpp"
 
+#include "baseline.hh"
+#include "batch.hh"
+#include "budget.hh"
 #include "code.hh"
-#include "comp_test/comp_test.hh"
+#include "code_size.hh"
+#include "comp_test/comp_test_info.hh"
+#include "compdb.hh"
 #include "compiler.hh"
 #include "executable.hh"
+#include "hotspots.hh"
+#include "jobserver.hh"
 #include "junit.hh"
-#include "lib/comp_test.hh"
+#include "lib/comp_test_info.hh"
 #include "log.hh"
+#include "memory.hh"
+#include "metrics.hh"
+#include "pch.hh"
+#include "pool.hh"
+#include "references.hh"
+#include "remarks.hh"
+#include "retention.hh"
+#include "run_stats.hh"
+#include "scaling.hh"
+#include "slice.hh"
 #include "test_case_run.hh"
 #include "test_suite_run.hh"
+#include "test_target.hh"
+#include "trace.hh"
+#include "watch.hh"
 
 namespace dhagedorn::comp_test::impl {
 
@@ -41,24 +62,99 @@ struct args {
     std::optional<std::string> temp;
     std::optional<std::string> junit;
     bool colour;
+    log_level level;
+    std::optional<std::string> trace;
+    bool trace_clang;
+    std::size_t hotspots;
+    std::optional<std::string> stats;
+    std::optional<std::string> metrics;
+    bool pch;
+    bool slice;
+    std::size_t batch;
+    bool cc1;
+    std::optional<std::string> compdb;
+    std::vector<std::string> files;
+    std::size_t jobs;
+    bool watch;
+    std::size_t output_limit_kb;
+    bool spill_output;
+    bool memory_aware;
+    std::size_t memory_reserve_mb;
+    std::optional<std::string> memory_profile;
+    std::optional<std::string> jobserver;
+    std::size_t repeat;
+    std::optional<std::string> write_baseline;
+    std::optional<std::string> baseline;
+    double regression_threshold;
+    bool gate_regressions;
     std::vector<std::string> compiler_args;
 
     void print() {
-        log("args",
-            "source",
-            source,
-            "compiler",
-            compiler,
-            "temp",
-            temp,
-            "junit",
-            junit,
-            "colour",
-            colour,
-            "compiler_args",
-            compiler_args,
-            "info binary",
-            info_binary);
+        log_debug("args",
+                  "source",
+                  source,
+                  "compiler",
+                  compiler,
+                  "temp",
+                  temp,
+                  "junit",
+                  junit,
+                  "colour",
+                  colour,
+                  "log level",
+                  to_string(level),
+                  "trace",
+                  trace,
+                  "trace clang",
+                  trace_clang,
+                  "hotspots",
+                  hotspots,
+                  "stats",
+                  stats,
+                  "metrics",
+                  metrics,
+                  "pch",
+                  pch,
+                  "slice",
+                  slice,
+                  "batch",
+                  batch,
+                  "cc1",
+                  cc1,
+                  "compdb",
+                  compdb,
+                  "files",
+                  files,
+                  "jobs",
+                  jobs,
+                  "watch",
+                  watch,
+                  "output limit kb",
+                  output_limit_kb,
+                  "spill output",
+                  spill_output,
+                  "memory aware",
+                  memory_aware,
+                  "memory reserve mb",
+                  memory_reserve_mb,
+                  "memory profile",
+                  memory_profile,
+                  "jobserver",
+                  jobserver,
+                  "repeat",
+                  repeat,
+                  "write baseline",
+                  write_baseline,
+                  "baseline",
+                  baseline,
+                  "regression threshold",
+                  regression_threshold,
+                  "gate regressions",
+                  gate_regressions,
+                  "compiler_args",
+                  compiler_args,
+                  "info binary",
+                  info_binary);
     }
 };
 
@@ -78,6 +174,18 @@ auto validate_opts(const po::variables_map &result,
         }
     };
 
+    check(log_level_from_string(result["log-level"].as<std::string>()),
+          "--log-level must be one of trace, debug, info, warning, error, "
+          "off");
+
+    // driver mode - everything else comes from the compilation database
+    if (result.count("compdb")) {
+        check(result.count("files") == 1,
+              "--files expected - sources in --compdb to run cases from");
+
+        return passed;
+    }
+
     check(result.count("info") == 1,
           "-i, --info expected - info binary to list test cases");
 
@@ -95,6 +203,20 @@ auto validate_opts(const po::variables_map &result,
     return passed;
 }
 
+/**
+ * Bazel only keeps test outputs written to TEST_UNDECLARED_OUTPUTS_DIR, so
+ * place relative paths there when it's set
+ */
+std::string output_path(const std::string &path) {
+    auto outputs_dir = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR");
+
+    if (!outputs_dir || bfs::path{path}.is_absolute()) {
+        return path;
+    }
+
+    return (bfs::path{outputs_dir} / path).native();
+}
+
 auto parse_opts(int argc, char **argv) {
     po::options_description options{
         R"(Runner for comp_test rule - invokes compiler for a source
@@ -108,6 +230,31 @@ auto parse_opts(int argc, char **argv) {
         ("temp,t", po::value<std::string>(), "Temp dir (defaults to system specified, but your build system may have another")
         ("junit,j", po::value<std::string>(), "Junit output file")
         ("no-colour", po::bool_switch()->default_value(false), "Disable colour in log output")
+        ("log-level", po::value<std::string>()->default_value("info"), "Minimum level to log - trace, debug, info, warning, error, or off")
+        ("trace", po::value<std::string>(), "Write a Chrome trace-event timeline of the run to this file.  Relative paths go to $TEST_UNDECLARED_OUTPUTS_DIR when set")
+        ("trace-clang", po::bool_switch()->default_value(false), "Compile with -ftime-trace and nest clang's own timeline under each compile in --trace")
+        ("hotspots", po::value<std::size_t>()->default_value(0), "Compile with -ftime-trace and report this many of the slowest template instantiations per case and for the run")
+        ("stats", po::value<std::string>(), "Write wall time, compiler invocations, and runner CPU time and peak RSS for the run to this JSON file.  Relative paths go to $TEST_UNDECLARED_OUTPUTS_DIR when set")
+        ("metrics", po::value<std::string>(), "Write each case's compile wall and CPU time, peak RSS and diagnostic lines, and the run's discovery time, concurrency, PCH hit rate, compiler versions and flags hashes, to this file - CSV if it ends in .csv, JSON otherwise.  Relative paths go to $TEST_UNDECLARED_OUTPUTS_DIR when set, and metrics.json is written there by default")
+        ("pch", po::bool_switch()->default_value(false), "Parse the source once into a precompiled header, and compile each case against it rather than re-parsing the source per case")
+        ("slice", po::bool_switch()->default_value(false), "Compile each case with the bodies of the source's other cases blanked out, so a case doesn't parse every other case.  Not needed with --pch")
+        ("batch", po::value<std::size_t>()->default_value(1), "Compile up to this many MUST_STATIC_ASSERT cases of a source at once, telling their static_asserts apart by instantiation, and compile any case that can't be told apart alone.  Ignored with --hotspots")
+        ("cc1", po::bool_switch()->default_value(false), "Ask the compiler driver once for the frontend command (clang -cc1) it runs, and run only that for each case.  Cases are compiled through the driver if it runs anything else")
+        ("compdb", po::value<std::string>(), "Driver mode - run the cases in every --files source of this compile_commands.json, instead of --info/--source/--compiler")
+        ("files", po::value<std::vector<std::string>>()->multitoken(), "Sources in --compdb to run - fnmatch globs, matched against absolute paths and paths relative to the database")
+        ("jobs", po::value<std::size_t>()->default_value(1), "Number of cases to compile at once")
+        ("output-limit", po::value<std::size_t>()->default_value(0), "Most compiler output, in KiB, to keep for each failing case until it is written to --junit - the rest is dropped, or spilled with --spill-output.  0 for no limit")
+        ("spill-output", po::bool_switch()->default_value(false), "Compress failing output over --output-limit to a temp file, and copy it back into --junit, rather than dropping it")
+        ("memory-aware", po::bool_switch()->default_value(false), "Start compiles only while there is memory free for them, up to --jobs at once, and kill the largest compile rather than let the system run out")
+        ("memory-reserve", po::value<std::size_t>()->default_value(1024), "Memory, in MiB, that --memory-aware keeps free for everything else")
+        ("memory-profile", po::value<std::string>(), "File that --memory-aware reads each case's peak memory from, and writes it back to after the run")
+        ("jobserver", po::value<std::string>(), "GNU make jobserver FIFO to take a token from for each compile, capping compiles across every runner sharing it.  A jobserver in MAKEFLAGS is joined without this, and the first compile there needs no token")
+        ("repeat", po::value<std::size_t>()->default_value(1), "Compile each case this many times, as samples of its compile CPU time and peak RSS for --write-baseline and --baseline.  COMP_SCALING cases are compiled this many times per size, 3 at least")
+        ("write-baseline", po::value<std::string>(), "Write each case's compile CPU time and peak RSS samples to this file.  Relative paths go to $TEST_UNDECLARED_OUTPUTS_DIR when set")
+        ("baseline", po::value<std::string>(), "Compare each case's compile CPU time and peak RSS against the samples in this --write-baseline file, and log the cases that regressed or improved, and the change over the whole run")
+        ("regression-threshold", po::value<double>()->default_value(10), "Percent a case's median must move by against --baseline to count as a regression or improvement, if the samples show it's not noise")
+        ("gate-regressions", po::bool_switch()->default_value(false), "Fail cases that regressed against --baseline")
+        ("watch", po::bool_switch()->default_value(false), "After the first run, stay running and re-run the cases of any source whose file or included headers are saved")
         ("help,h", "This menu")
     ;
     // clang-format on
@@ -135,10 +282,16 @@ auto parse_opts(int argc, char **argv) {
         std::exit(1);
     };
 
+    // not given in driver mode
+    auto or_empty = [&](auto name) {
+        return parsed_opts.count(name) ? parsed_opts[name].as<std::string>()
+                                       : "";
+    };
+
     return args{
-        parsed_opts["info"].as<std::string>(),
-        parsed_opts["source"].as<std::string>(),
-        parsed_opts["compiler"].as<std::string>(),
+        or_empty("info"),
+        or_empty("source"),
+        or_empty("compiler"),
         opt_if(parsed_opts.count("temp")).then([&] {
             return parsed_opts["temp"].as<std::string>();
         }),
@@ -146,89 +299,996 @@ auto parse_opts(int argc, char **argv) {
             return parsed_opts["junit"].as<std::string>();
         }),
         !parsed_opts["no-colour"].as<bool>(),
+        *log_level_from_string(parsed_opts["log-level"].as<std::string>()),
+        opt_if(parsed_opts.count("trace")).then([&] {
+            return output_path(parsed_opts["trace"].as<std::string>());
+        }),
+        parsed_opts["trace-clang"].as<bool>(),
+        parsed_opts["hotspots"].as<std::size_t>(),
+        opt_if(parsed_opts.count("stats")).then([&] {
+            return output_path(parsed_opts["stats"].as<std::string>());
+        }),
+        // always kept under bazel test, for dashboards
+        opt_if(parsed_opts.count("metrics")
+               || std::getenv("TEST_UNDECLARED_OUTPUTS_DIR"))
+            .then([&] {
+                return output_path(
+                    parsed_opts.count("metrics")
+                        ? parsed_opts["metrics"].as<std::string>()
+                        : "metrics.json");
+            }),
+        parsed_opts["pch"].as<bool>(),
+        parsed_opts["slice"].as<bool>(),
+        parsed_opts["batch"].as<std::size_t>(),
+        parsed_opts["cc1"].as<bool>(),
+        opt_if(parsed_opts.count("compdb")).then([&] {
+            return parsed_opts["compdb"].as<std::string>();
+        }),
+        parsed_opts.count("files")
+            ? parsed_opts["files"].as<std::vector<std::string>>()
+            : std::vector<std::string>{},
+        parsed_opts["jobs"].as<std::size_t>(),
+        parsed_opts["watch"].as<bool>(),
+        parsed_opts["output-limit"].as<std::size_t>(),
+        parsed_opts["spill-output"].as<bool>(),
+        parsed_opts["memory-aware"].as<bool>(),
+        parsed_opts["memory-reserve"].as<std::size_t>(),
+        opt_if(parsed_opts.count("memory-profile")).then([&] {
+            return parsed_opts["memory-profile"].as<std::string>();
+        }),
+        opt_if(parsed_opts.count("jobserver")).then([&] {
+            return parsed_opts["jobserver"].as<std::string>();
+        }),
+        parsed_opts["repeat"].as<std::size_t>(),
+        opt_if(parsed_opts.count("write-baseline")).then([&] {
+            return output_path(parsed_opts["write-baseline"].as<std::string>());
+        }),
+        opt_if(parsed_opts.count("baseline")).then([&] {
+            return parsed_opts["baseline"].as<std::string>();
+        }),
+        parsed_opts["regression-threshold"].as<double>(),
+        parsed_opts["gate-regressions"].as<bool>(),
         positional,
     };
 }
 
-auto run_case(const args &args, const test_case &tc) {
-    auto c = code(tc.file);
+/** one line per case, as soon as it finishes */
+void log_result(const testcase_run &run) {
+    auto name = fmt::format("{} {}", run.tc.object, run.tc.verb);
+
+    switch (run.result()) {
+        case test_case_result::pass:
+            log("pass", "case", name, "duration", run.duration);
+            break;
+        case test_case_result::fail:
+            log_error(
+                "fail", "case", name, "why", *run.fail_or_error_message());
+            break;
+        case test_case_result::error:
+            log_error(
+                "error", "case", name, "why", *run.fail_or_error_message());
+            break;
+        case test_case_result::skipped:
+            log("skipped", "case", name);
+            break;
+    }
+}
 
-    auto start = std::chrono::steady_clock::now();
+using pending_pch = std::shared_future<std::optional<precompiled_source>>;
+
+/** --memory-aware state, shared by every case */
+struct memory_limits {
+    memory_limits(long reserve_kb)
+        : governor{reserve_kb} {}
+
+    memory_governor governor;
+    memory_profile profile;
+};
+
+/**
+ * Compile a case once there's memory for it, and again with nothing else
+ * running if it was killed to free memory
+ *
+ * Empty if it can't be compiled in the memory there is
+ */
+std::optional<compile_result> compile_within_memory(memory_limits &memory,
+                                                    compiler &comp,
+                                                    const bfs::path &input,
+                                                    const std::string &key) {
+    for (auto alone : {false, true}) {
+        auto slot = memory.governor.acquire(memory.profile.peak_kb(key), alone);
+
+        if (!slot) {
+            return {};
+        }
+
+        auto result = comp.compile(
+            input, {}, [&](int pid) { slot->started(pid); });
+
+        // a killed compile's peak is a lower bound - still worth knowing.  0
+        // is no measurement (no rusage), and would let it start anywhere
+        if (result.compile_output.peak_rss_kb > 0) {
+            memory.profile.record(key, result.compile_output.peak_rss_kb);
+        }
 
-    fmt::print("{}\n", tc.symbol);
+        if (!slot->killed()) {
+            return result;
+        }
+
+        log_warning("compile killed to free memory",
+                    "case",
+                    key,
+                    "retrying alone",
+                    !alone);
+    }
 
-    auto runner = fmt::format(
-        R"(
-        struct TestCaseInstantiation {{
+    return {};
+}
+
+/**
+ * main() instantiating each case's test function - with its own TestCase
+ * type per case when there's more than one, see batch_instantiation()
+ * size: TestCase::size, for COMP_SCALING cases
+ */
+std::string instantiation_main(const std::vector<test_case> &cases,
+                               unsigned long size = 0) {
+    std::string structs;
+    std::string calls;
+
+    for (std::size_t i = 0; i < cases.size(); i++) {
+        auto &tc = cases[i];
+        auto name = cases.size() == 1 ? "TestCaseInstantiation"s
+                                      : batch_instantiation(i);
+
+        structs += fmt::format(
+            R"(
+        struct {} {{
             static constexpr const char* suite = "{}";
             static constexpr const char* object = "{}";
             static constexpr const char* verb = "{}";
             static constexpr const char* expected_static_assert = "{}";
             static constexpr const char* file = "{}";
             static constexpr unsigned line = {};
+            static constexpr unsigned long size = {};
         }};
+)",
+            name,
+            "",
+            // tc.test_suite(),
+            tc.object,
+            tc.verb,
+            tc.expected_assert_message,
+            tc.file,
+            tc.line,
+            size);
+
+        calls += fmt::format(
+            R"(
+            {}{}<{}>();)",
+            tc.test_suite_symbol() == "" ? ""s : tc.test_suite_symbol() + "::",
+            tc.symbol,
+            name);
+    }
 
+    return fmt::format(
+        R"({}
         int main() {{
-            // instantiate test function, should static assert
-            {}{}<TestCaseInstantiation>();
+            // instantiate test function, should static assert{}
             return 0;
         }}
     )",
-        "",
-        // tc.test_suite(),
-        tc.object,
-        tc.verb,
-        tc.expected_assert_message,
-        tc.file,
-        tc.line,
-        tc.test_suite_symbol() == "" ? ""s : tc.test_suite_symbol() + "::",
-        tc.symbol);
+        structs,
+        calls);
+}
 
-    c.append(runner);
+/**
+ * a compile the runner gave up on, with why as its output - reported as an
+ * error: not compiled, and no static_assert
+ */
+compile_result not_compiled(std::string why) {
+    auto result = compile_result{};
+    result.compiled = false;
+    result.compile_output.exit_code = -1;
+    result.compile_output.stderr = {"comp_test: " + why};
+
+    return result;
+}
 
-    auto comp = compiler(args.compiler, args.compiler_args);
+/** how a compile of cases differs from the plain one */
+struct compile_variant {
+    // TestCase::size, for COMP_SCALING cases
+    unsigned long size = 0;
+    // appended to the compiler args
+    std::vector<std::string> extra_args = {};
+    // have clang write its -ftime-trace, without --trace-clang or --hotspots
+    bool time_trace = false;
+    // the lines of the cases whose bodies are kept, every other blanked -
+    // even without --slice, and never from the PCH, which has every body
+    std::optional<std::vector<unsigned long>> bodies = {};
+};
 
-    log("compiling...");
+/**
+ * whether tc is declared in the target's source, not in a header it
+ * includes - only those cases' bodies can be sliced
+ */
+bool declared_in_source(const test_target &target, const test_case &tc) {
+    auto base = target.directory.empty() ? bfs::current_path()
+                                         : target.directory;
 
-    auto result = comp.compile(c.as_file());
+    return bfs::weakly_canonical(bfs::absolute(tc.file, base))
+           == bfs::weakly_canonical(bfs::absolute(target.source));
+}
+
+/** compile the source with main() instantiating cases */
+compile_result compile_cases(const args &args,
+                             const test_target &target,
+                             const std::vector<test_case> &cases,
+                             const pending_pch &pending,
+                             const std::shared_ptr<const sliced_source> &slices,
+                             memory_limits *memory,
+                             const compile_variant &variant = {}) {
+    auto &pch = pending.get();
+
+    // a PCH built at another -O is rejected by clang, as __OPTIMIZE__ differs
+    auto reoptimized = r::any_of(variant.extra_args, [](auto &arg) {
+        return arg.rfind("-O", 0) == 0;
+    });
+
+    auto use_pch = pch && pch->built() && !variant.bodies && !reoptimized;
+
+    auto sliced = variant.bodies && !slices
+                      ? std::make_shared<const sliced_source>(target.source)
+                      : slices;
+
+    // cases declared in an included header aren't in the slices
+    auto in_source = r::all_of(
+        cases, [&](auto &tc) { return declared_in_source(target, tc); });
+
+    auto c = code{};
+
+    // with a PCH, the source comes from -include
+    if (sliced && in_source && !use_pch) {
+        c.append(line_marker(target.source));
+        c.append(sliced->for_cases(
+            variant.bodies ? *variant.bodies
+                           : cases | rv::transform(&test_case::line)
+                                 | r::to<std::vector>()));
+    } else if (!use_pch) {
+        c = code{target.source};
+    }
+
+    c.append(instantiation_main(cases, variant.size));
+
+    auto compiler_args = use_pch
+                             ? pch->case_args()
+                             : copy_args(target.source, target.compiler_args);
+    compiler_args.insert(compiler_args.end(),
+                         variant.extra_args.begin(),
+                         variant.extra_args.end());
+
+    auto comp = compiler(target.compiler,
+                         compiler_args,
+                         args.trace_clang || args.hotspots > 0
+                             || variant.time_trace,
+                         target.directory,
+                         args.cc1);
+
+    log_debug("compiling...");
+
+    auto input = c.as_file();
+
+    if (!memory) {
+        auto result = comp.compile(input);
+        result.pch = use_pch;
+
+        return result;
+    }
+
+    auto key = fmt::format(
+        "{} {}{}",
+        target.source,
+        fmt::join(cases | rv::transform(&test_case::symbol)
+                      | r::to<std::vector>(),
+                  ","),
+        variant.size ? fmt::format("@{}", variant.size) : "");
+
+    if (auto result = compile_within_memory(*memory, comp, input, key)) {
+        result->pch = use_pch;
+        return *result;
+    }
+
+    auto out_of_memory = not_compiled(
+        fmt::format("not enough memory to compile this case with {} MiB kept "
+                    "free (--memory-reserve)",
+                    args.memory_reserve_mb));
+    out_of_memory.input = input;
+
+    return out_of_memory;
+}
+
+/** time since start, as a case's duration */
+std::chrono::milliseconds elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+}
+
+/**
+ * a case whose macro arguments don't parse, reported as an error
+ * expected: what the arguments should be
+ */
+testcase_run invalid_limits(const test_case &tc,
+                            const std::string &expected,
+                            std::chrono::steady_clock::time_point start) {
+    auto invalid = not_compiled(fmt::format(
+        "{}({}) - expected {}", to_string(tc.type), tc.limits, expected));
+
+    return testcase_run{tc, invalid, elapsed(start)};
+}
+
+/**
+ * Compile a COMP_SCALING case at each of its sizes, and fit its compile
+ * time curve - each size is compiled --repeat times, 3 at least, and its
+ * median CPU time taken
+ */
+testcase_run run_scaling(const args &args,
+                         const test_target &target,
+                         const test_case &tc,
+                         const pending_pch &pending,
+                         const std::shared_ptr<const sliced_source> &slices,
+                         memory_limits *memory) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto spec = scaling_spec::parse(tc.limits);
+
+    if (!spec) {
+        return invalid_limits(tc,
+                              "a bound (constant, logarithmic, linear, "
+                              "linearithmic, quadratic or cubic), then 3 or "
+                              "more sizes, or none for the defaults",
+                              start);
+    }
+
+    auto repeat = std::max<std::size_t>(args.repeat, 3);
+
+    std::vector<scaling_point> curve;
+    compile_result result;
+
+    for (auto size : spec->sizes) {
+        auto span = trace_span{
+            "scaling size", "runner", {{"size", fmt::format("{}", size)}}};
+
+        std::vector<double> cpu_ms;
+
+        for (std::size_t i = 0; i < repeat; i++) {
+            result = compile_cases(args,
+                                   target,
+                                   {tc},
+                                   pending,
+                                   slices,
+                                   memory,
+                                   compile_variant{size});
+
+            // the failing size's output is what's reported
+            if (!result.compiled) {
+                return testcase_run{tc, result, elapsed(start)};
+            }
+
+            cpu_ms.push_back(result.compile_output.cpu_seconds * 1000);
+        }
+
+        curve.push_back({size, median(cpu_ms)});
+    }
+
+    auto run = testcase_run{tc, result, elapsed(start)};
+    run.scaling
+        = scaling_result{spec->bound, scaling_fit::of(std::move(curve))};
+
+    log("compile time scaling",
+        "case",
+        tc.symbol,
+        "bound",
+        to_string(spec->bound),
+        "curve",
+        run.scaling->fit.to_string());
+
+    return run;
+}
+
+/**
+ * Compile a COMP_BUDGET case, and count what it cost - counts are the same
+ * every run, unlike compile times
+ *
+ * Counts are of the source with only this case's body kept, against the
+ * source with every body blanked.  Instantiations are counted in clang's
+ * -ftime-trace at full granularity.  Constexpr steps are found by bisecting
+ * -fconstexpr-steps (clang) or -fconstexpr-ops-limit (gcc) below the budget,
+ * for the least each compiles with - the limit is per evaluation, so below
+ * the source's own least, the case's can't be told apart from the source's.
+ */
+testcase_run run_budget(const args &args,
+                        const test_target &target,
+                        const test_case &tc,
+                        const pending_pch &pending,
+                        const std::shared_ptr<const sliced_source> &slices,
+                        memory_limits *memory) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto spec = budget_spec::parse(tc.limits);
+
+    if (!spec) {
+        return invalid_limits(
+            tc, "instantiations(<n>) and/or constexpr_steps(<n>)", start);
+    }
+
+    auto clang
+        = compiler{target.compiler, {}, false, target.directory}.is_clang();
+
+    auto counted = spec->instantiations && clang;
+
+    // the case's body kept, or none, and every other blanked
+    auto bodies = [&](bool with_case) {
+        return with_case ? std::vector<unsigned long>{tc.line}
+                         : std::vector<unsigned long>{};
+    };
+
+    auto counting = [&](bool with_case) {
+        return counted ? compile_variant{0,
+                                         {"-ftime-trace-granularity=0"},
+                                         true,
+                                         bodies(with_case)}
+                       : compile_variant{0, {}, false, bodies(with_case)};
+    };
+
+    auto result = compile_cases(
+        args, target, {tc}, pending, slices, memory, counting(true));
+
+    if (!result.compiled) {
+        return testcase_run{tc, result, elapsed(start)};
+    }
+
+    auto budget = budget_result{*spec};
+
+    if (spec->instantiations && !clang) {
+        budget.unmeasured = "instantiations are counted in clang's "
+                            "-ftime-trace, and the compiler isn't clang";
+    } else if (counted) {
+        auto alone = compile_cases(
+            args, target, {}, pending, slices, memory, counting(false));
+
+        if (result.time_trace && alone.time_trace) {
+            auto total = count_instantiations(*result.time_trace);
+            auto source = count_instantiations(*alone.time_trace);
+
+            budget.instantiations = total > source ? total - source : 0;
+        } else {
+            budget.unmeasured = "clang wrote no -ftime-trace to count "
+                                "instantiations in";
+        }
+    }
+
+    if (spec->constexpr_steps) {
+        auto flag = clang ? "-fconstexpr-steps" : "-fconstexpr-ops-limit";
+
+        // to within 1% - exact for small counts - or empty if more than the
+        // budget
+        auto least_steps = [&](bool with_case) -> std::optional<unsigned long> {
+            auto compiles_within = [&](unsigned long steps) {
+                return compile_cases(
+                           args,
+                           target,
+                           with_case ? std::vector<test_case>{tc}
+                                     : std::vector<test_case>{},
+                           pending,
+                           slices,
+                           memory,
+                           compile_variant{0,
+                                           {fmt::format("{}={}", flag, steps)},
+                                           false,
+                                           bodies(with_case)})
+                    .compiled;
+            };
+
+            if (!compiles_within(*spec->constexpr_steps)) {
+                return {};
+            }
+
+            unsigned long fails = 0;
+            auto compiles = *spec->constexpr_steps;
+
+            while (compiles - fails > std::max(1UL, compiles / 100)) {
+                auto steps = fails + (compiles - fails) / 2;
+                (compiles_within(steps) ? compiles : fails) = steps;
+            }
+
+            return compiles;
+        };
+
+        budget.source_constexpr_steps = least_steps(false);
+
+        if (budget.source_constexpr_steps) {
+            budget.constexpr_steps = least_steps(true);
+        } else {
+            budget.unmeasured = fmt::format(
+                "the source takes more than {} constexpr steps outside its "
+                "cases",
+                *spec->constexpr_steps);
+        }
+    }
+
+    log("compile budget", "case", tc.symbol, "counts", budget.to_string());
+
+    auto run = testcase_run{tc, result, elapsed(start)};
+    run.budget = std::move(budget);
+
+    return run;
+}
+
+/** a case's object, and the source's without it, compiled alike */
+struct compared_objects {
+    // the case's compile, which is reported
+    compile_result result;
+    std::optional<elf_object> with_case = {};
+    std::optional<elf_object> without = {};
+    // why the objects can't be compared, if the case compiled
+    std::optional<std::string> unmeasured = {};
+};
+
+/**
+ * Compile tc, and if it compiles, the source without it, and read both
+ * objects
+ */
+compared_objects
+compile_objects(const args &args,
+                const test_target &target,
+                const test_case &tc,
+                const pending_pch &pending,
+                const std::shared_ptr<const sliced_source> &slices,
+                memory_limits *memory,
+                const compile_variant &variant) {
+    auto objects = compared_objects{
+        compile_cases(args, target, {tc}, pending, slices, memory, variant)};
+
+    if (!objects.result.compiled) {
+        return objects;
+    }
+
+    auto alone
+        = compile_cases(args, target, {}, pending, slices, memory, variant);
+
+    auto read = [](const compile_result &compiled) {
+        return compiled.binary ? elf_object::read(*compiled.binary)
+                               : std::nullopt;
+    };
+
+    objects.with_case = read(objects.result);
+    objects.without = read(alone);
+
+    if (!alone.compiled) {
+        objects.unmeasured = "the source didn't compile without the case";
+    } else if (!objects.with_case || !objects.without) {
+        objects.unmeasured = "the compiler didn't write an ELF object - ex "
+                             "with -flto, or -fsyntax-only";
+    }
+
+    return objects;
+}
+
+/**
+ * Compile a COMP_CODE_SIZE case, and the source without it, and compare the
+ * code in their objects
+ */
+testcase_run run_code_size(const args &args,
+                           const test_target &target,
+                           const test_case &tc,
+                           const pending_pch &pending,
+                           const std::shared_ptr<const sliced_source> &slices,
+                           memory_limits *memory) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto spec = code_size_spec::parse(tc.limits);
+
+    if (!spec) {
+        return invalid_limits(tc, "a budget in bytes", start);
+    }
+
+    auto objects
+        = compile_objects(args, target, tc, pending, slices, memory, {});
+
+    if (!objects.result.compiled) {
+        return testcase_run{tc, objects.result, elapsed(start)};
+    }
+
+    auto code_size = code_size_result{*spec};
+
+    if (objects.unmeasured) {
+        code_size.unmeasured = objects.unmeasured;
+    } else {
+        code_size = code_size_result::of(
+            *spec, *objects.with_case, *objects.without);
+    }
+
+    log("code size", "case", tc.symbol, "size", code_size.to_string());
+
+    auto run = testcase_run{tc, objects.result, elapsed(start)};
+    run.code_size = std::move(code_size);
+
+    return run;
+}
+
+/** whether args leave the compiler optimizing - the last -O isn't -O0 */
+bool optimizes(const std::vector<std::string> &args) {
+    auto level = std::find_if(args.rbegin(), args.rend(), [](auto &arg) {
+        return arg.rfind("-O", 0) == 0;
+    });
+
+    return level != args.rend() && *level != "-O0";
+}
+
+/**
+ * Compile a MUST_NOT_REFERENCE case, with -O2 if the source isn't already
+ * optimized, and the source without it, and compare the symbols their code
+ * refers to
+ */
+testcase_run run_references(const args &args,
+                            const test_target &target,
+                            const test_case &tc,
+                            const pending_pch &pending,
+                            const std::shared_ptr<const sliced_source> &slices,
+                            memory_limits *memory) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto spec = reference_spec::parse(tc.limits);
+
+    if (!spec) {
+        return invalid_limits(
+            tc, "the symbols the case mustn't refer to", start);
+    }
+
+    // unoptimized, every inline function the case uses is a call
+    auto variant = optimizes(target.compiler_args)
+                       ? compile_variant{}
+                       : compile_variant{0, {"-O2"}};
+
+    auto objects
+        = compile_objects(args, target, tc, pending, slices, memory, variant);
+
+    if (!objects.result.compiled) {
+        return testcase_run{tc, objects.result, elapsed(start)};
+    }
+
+    auto references = reference_result{*spec};
+
+    if (objects.unmeasured) {
+        references.unmeasured = objects.unmeasured;
+    } else {
+        references = reference_result::of(
+            *spec, *objects.with_case, *objects.without);
+    }
+
+    log("forbidden references",
+        "case",
+        tc.symbol,
+        "references",
+        references.to_string());
+
+    auto run = testcase_run{tc, objects.result, elapsed(start)};
+    run.references = std::move(references);
+
+    return run;
+}
+
+/**
+ * Compile a MUST_VECTORIZE or MUST_INLINE case with the optimizer's
+ * remarks, and -O2 if the source isn't already optimized, and check those
+ * remarks on the lines of its body
+ */
+testcase_run
+run_optimization(const args &args,
+                 const test_target &target,
+                 const test_case &tc,
+                 const pending_pch &pending,
+                 const std::shared_ptr<const sliced_source> &slices,
+                 memory_limits *memory) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto wanted = tc.type == comp_test::test_type::MUST_VECTORIZE
+                      ? optimization::vectorize
+                      : optimization::inline_call;
+
+    auto clang
+        = compiler{target.compiler, {}, false, target.directory}.is_clang();
+
+    // unoptimized, nothing is vectorized or inlined to remark on
+    auto extra_args = remark_args(wanted, clang);
+
+    if (!optimizes(target.compiler_args)) {
+        extra_args.push_back("-O2");
+    }
+
+    auto result = compile_cases(args,
+                                target,
+                                {tc},
+                                pending,
+                                slices,
+                                memory,
+                                compile_variant{0, extra_args});
+
+    if (!result.compiled) {
+        return testcase_run{tc, result, elapsed(start)};
+    }
+
+    auto base = target.directory.empty() ? bfs::current_path()
+                                         : target.directory;
+
+    // copies of the source - compiled, or the PCH's - are marked with its
+    // path, so remarks in the body name the case's own file either way
+    auto file = bfs::weakly_canonical(bfs::absolute(tc.file, base));
+
+    auto lines = sliced_source{file.native()}.body_lines(tc.line);
+    auto optimized = optimization_result{wanted};
+
+    if (!lines) {
+        optimized.unmeasured = "the case's body wasn't found in its file";
+    } else {
+        optimized = optimization_result::of(
+            wanted, result.diagnostics, [&](auto &diag) {
+                if (diag.line < lines->first || diag.line > lines->second) {
+                    return false;
+                }
+
+                auto path
+                    = bfs::weakly_canonical(bfs::absolute(diag.path, base));
+
+                return path == file;
+            });
+    }
+
+    log("optimization remarks",
+        "case",
+        tc.symbol,
+        "remarks",
+        optimized.to_string());
+
+    auto run = testcase_run{tc, result, elapsed(start)};
+    run.optimization = std::move(optimized);
+
+    return run;
+}
+
+auto run_case(const args &args,
+              const test_target &target,
+              const test_case &tc,
+              hotspot_totals &run_hotspots,
+              const pending_pch &pending,
+              const std::shared_ptr<const sliced_source> &slices,
+              memory_limits *memory) {
+    auto span = trace_span{"run_case", "runner", {{"case", tc.symbol}}};
+
+    if (tc.decided()) {
+        log("decided by the info binary", "case", tc.symbol);
+        return testcase_run{tc, {}, 0ms};
+    }
+
+    if (tc.type == comp_test::test_type::COMP_SCALING) {
+        log("running", "case", tc.symbol, "sizes", tc.limits);
+        return run_scaling(args, target, tc, pending, slices, memory);
+    }
+
+    if (tc.type == comp_test::test_type::COMP_BUDGET) {
+        log("running", "case", tc.symbol, "budget", tc.limits);
+        return run_budget(args, target, tc, pending, slices, memory);
+    }
+
+    if (tc.type == comp_test::test_type::COMP_CODE_SIZE) {
+        log("running", "case", tc.symbol, "budget", tc.limits);
+        return run_code_size(args, target, tc, pending, slices, memory);
+    }
+
+    if (tc.type == comp_test::test_type::MUST_VECTORIZE
+        || tc.type == comp_test::test_type::MUST_INLINE) {
+        log("running", "case", tc.symbol);
+        return run_optimization(args, target, tc, pending, slices, memory);
+    }
+
+    if (tc.type == comp_test::test_type::MUST_NOT_REFERENCE) {
+        log("running", "case", tc.symbol, "forbidden", tc.limits);
+        return run_references(args, target, tc, pending, slices, memory);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    log("running", "case", tc.symbol);
+
+    auto result = compile_cases(args, target, {tc}, pending, slices, memory);
 
     auto duration = std::chrono::steady_clock::now() - start;
 
-    return testcase_run{
+    auto run = testcase_run{
         tc,
         result,
         std::chrono::duration_cast<std::chrono::milliseconds>(duration),
     };
+
+    auto sample = [](const compile_result &compiled) {
+        return compile_sample{
+            compiled.compile_output.cpu_seconds * 1000,
+            compiled.compile_output.peak_rss_kb,
+        };
+    };
+
+    run.samples.push_back(sample(result));
+
+    // only the first compile's output is kept
+    for (std::size_t i = 1; i < args.repeat; i++) {
+        run.samples.push_back(sample(
+            compile_cases(args, target, {tc}, pending, slices, memory)));
+    }
+
+    if (args.hotspots > 0 && result.time_trace) {
+        auto hotspots = template_hotspots(read_time_trace(*result.time_trace));
+
+        run_hotspots.add(hotspots);
+        run.hotspots = top_hotspots(std::move(hotspots), args.hotspots);
+
+        log("template hotspots",
+            "case",
+            tc.symbol,
+            "slowest",
+            run.hotspots | rv::transform(&template_hotspot::to_string));
+    }
+
+    return run;
+}
+
+/**
+ * Compile several cases at once, and split the output per case - nothing
+ * for any case the batch couldn't decide, see split_batch()
+ */
+auto run_batch(const args &args,
+               const test_target &target,
+               const std::vector<test_case> &cases,
+               const pending_pch &pending,
+               const std::shared_ptr<const sliced_source> &slices,
+               memory_limits *memory) {
+    auto span = trace_span{
+        "run_batch", "runner", {{"cases", fmt::format("{}", cases.size())}}};
+
+    auto start = std::chrono::steady_clock::now();
+
+    log("running batch",
+        "cases",
+        cases | rv::transform(&test_case::symbol));
+
+    auto result = compile_cases(args, target, cases, pending, slices, memory);
+
+    // shared evenly - there's no telling what each case cost
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        (std::chrono::steady_clock::now() - start) / cases.size());
+
+    auto split = split_batch(result, cases);
+
+    std::vector<std::optional<testcase_run>> runs;
+
+    for (std::size_t i = 0; i < cases.size(); i++) {
+        if (split[i]) {
+            runs.push_back(testcase_run{cases[i], *split[i], duration});
+        } else {
+            runs.push_back({});
+        }
+    }
+
+    log_debug("batch split",
+              "decided",
+              r::count_if(runs, [](auto &run) { return run.has_value(); }),
+              "of",
+              runs.size());
+
+    return runs;
 }
 
 using suites_with_cases = std::unordered_map<comp_test::test_suite,
                                              std::vector<comp_test::test_case>>;
 
-auto run_tests(const args &args, const suites_with_cases &suites) {
-    std::vector<test_suite_run> suite_runs;
+using discovered_tests
+    = std::tuple<std::vector<test_suite>, std::vector<test_case>>;
 
-    for (const auto &[suite, cases] : suites) {
-        auto suite_run = test_suite_run{suite};
+/**
+ * main() of info_binary_main.cc, appended to a source with no prebuilt info
+ * binary - the source itself includes only comp_test.hh
+ */
+const auto info_main = R"(
+#include "comp_test/comp_test_info.hh"
 
-        for (const auto &tc : cases) {
-            auto result = run_case(args, tc);
-            suite_run.case_runs.push_back(result);
-        }
+int main() {
+    for (const auto &ts : dhagedorn::comp_test::_test_suites()) {
+        std::cout << "test_suite:" << ts.to_string() << std::endl;
+    }
 
-        suite_runs.push_back(suite_run);
+    for (const auto &tc : dhagedorn::comp_test::_test_cases()) {
+        std::cout << "test_case:" << tc.to_string() << std::endl;
     }
 
-    return suite_runs;
+    return 0;
 }
+)";
+
+/**
+ * Compile and link an info binary for a source, as cc_comp_test does at build
+ * time
+ *
+ * Symbols from libraries the source isn't linked against are left
+ * unresolved - listing cases only runs the registrations, never the code
+ * under test
+ */
+std::optional<bfs::path> build_info_binary(const test_target &target) {
+    auto span = trace_span{
+        "build_info_binary", "runner", {{"source", target.source}}};
+
+    auto c = code{target.source};
+    c.append(info_main);
+
+    auto comp = compiler{target.compiler,
+                         copy_args(target.source, target.compiler_args),
+                         false,
+                         target.directory};
 
-auto get_tests(const args &args) {
-    auto c = code(args.source);
+    auto result = comp.compile(c.as_file());
+
+    if (!result.compiled) {
+        log_error("could not compile source to discover its cases",
+                  "source",
+                  target.source,
+                  "diagnostics",
+                  result.diagnostics
+                      | rv::transform(&compiler_diagnostic::original));
+        return {};
+    }
 
-    auto info = executable{args.info_binary};
+    auto binary = bfs::path{*result.binary}.replace_extension("");
 
-    auto output = info.run();
+    auto token = jobserver::instance().acquire();
 
-    log("raw output", "output", output.stdout);
+    auto link_args = comp.link_args(*result.binary, binary);
+    link_args.push_back("-Wl,--unresolved-symbols=ignore-all");
+
+    auto link
+        = executable{target.compiler, link_args, target.directory}.run();
+
+    if (link.exit_code != 0) {
+        log_error("could not link info binary",
+                  "source",
+                  target.source,
+                  "output",
+                  link.stderr);
+        return {};
+    }
+
+    return binary;
+}
+
+std::optional<discovered_tests> get_tests(const test_target &target) {
+    auto span = trace_span{"get_tests", "runner", {{"source", target.source}}};
+
+    auto info_binary = target.info_binary
+                           ? std::optional<bfs::path>{*target.info_binary}
+                           : build_info_binary(target);
+
+    if (!info_binary) {
+        return {};
+    }
+
+    auto output = executable{*info_binary}.run();
+
+    log_trace("raw output", "output", output.stdout);
+
+    if (output.exit_code != 0) {
+        log_error("info binary failed",
+                  "source",
+                  target.source,
+                  "exit code",
+                  output.exit_code);
+        return {};
+    }
 
     auto filter_and_strip = [](std::string_view prefix) {
         return rv::remove_if(
@@ -237,8 +1297,6 @@ auto get_tests(const args &args) {
                    [=](auto &val) { return val.substr(prefix.size()); });
     };
 
-    log("stdout", "output", output.stdout);
-
     auto to_vector = r::to<std::vector>();
 
     auto suites = output.stdout | filter_and_strip("test_suite:")
@@ -247,7 +1305,17 @@ auto get_tests(const args &args) {
     auto cases = output.stdout | filter_and_strip("test_case:")
                  | rv::transform(&test_case::from_string) | to_vector;
 
-    return std::tuple{suites, cases};
+    log_debug("test info",
+              "source",
+              target.source,
+              "suites",
+              suites | rv::transform([](auto &suite) { return suite.symbol; }),
+              "cases' suites",
+              cases | rv::transform([](auto &tc) {
+                  return tc.test_suite_symbol();
+              }));
+
+    return discovered_tests{suites, cases};
 }
 
 auto connect(std::vector<test_suite> &suites, std::vector<test_case> &cases) {
@@ -278,50 +1346,551 @@ auto connect(std::vector<test_suite> &suites, std::vector<test_case> &cases) {
     return map;
 }
 
-auto write_junit(const args &args, const std::vector<test_suite_run> &results) {
-    if (args.junit) {
-        junit j;
-        j.write(results, *args.junit);
+/** --write-baseline and --baseline, for run_tests */
+struct run_baselines {
+    std::optional<compile_baseline> written;
+    std::optional<baseline_comparison> compared;
+};
+
+/** record a case's samples, and compare them, failing it if gated */
+void compare_to_baseline(const args &args,
+                         run_baselines &baselines,
+                         const std::string &key,
+                         testcase_run &run) {
+    if (baselines.written) {
+        baselines.written->record(key, run.samples);
+    }
+
+    if (!baselines.compared) {
+        return;
+    }
+
+    for (auto &change : baselines.compared->compare(key, run.samples)) {
+        if (change.regressed) {
+            log_warning(
+                "compile regressed", "case", key, "change", change.to_string());
+
+            if (args.gate_regressions && !run.regression) {
+                run.regression = change.to_string();
+            }
+        } else if (change.improved) {
+            log("compile improved", "case", key, "change", change.to_string());
+        }
+    }
+}
+
+/** a suite, and its cases queued on the pool in order */
+struct scheduled_suite {
+    comp_test::test_suite suite;
+    std::vector<std::future<testcase_run>> cases;
+};
+
+/**
+ * Discover and run the cases of every target on one pool
+ *
+ * Discovery for every target is queued first, so compiles for one target's
+ * cases overlap discovery of the next.  Results are then taken in order, so
+ * each suite is written to the JUnit report whole, as soon as its cases are
+ * done.
+ */
+auto run_tests(const args &args,
+               const std::vector<test_target> &targets,
+               worker_pool &pool,
+               memory_limits *memory,
+               run_metrics *metrics,
+               run_baselines *baselines,
+               std::optional<junit> &out) {
+    std::vector<test_suite_run> suite_runs;
+    hotspot_totals run_hotspots;
+    bool discovery_failed = false;
+
+    auto time_trace = args.trace_clang || args.hotspots > 0;
+
+    auto retention = retention_policy{
+        args.output_limit_kb * 1024,
+        args.spill_output,
+    };
+
+    std::vector<std::future<std::optional<discovered_tests>>> discoveries;
+
+    for (auto &target : targets) {
+        discoveries.push_back(pool.submit([&] {
+            auto start = std::chrono::steady_clock::now();
+            auto tests = get_tests(target);
+
+            if (metrics) {
+                metrics->add_source(
+                    target,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start));
+            }
+
+            return tests;
+        }));
+    }
+
+    std::vector<scheduled_suite> scheduled;
+
+    // waited on before returning - a source with no compiled cases doesn't
+    // wait for its PCH, which refers to the target and writes to TMPDIR
+    std::vector<pending_pch> pchs;
+
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        auto &target = targets[i];
+        auto tests = discoveries[i].get();
+
+        if (!tests) {
+            discovery_failed = true;
+            continue;
+        }
+
+        auto &[suites, cases] = *tests;
+        auto connected = connect(suites, cases);
+
+        // up front, so cases that would share a key are numbered in order
+        auto keys = std::make_shared<
+            std::map<std::pair<std::string, unsigned long>, std::string>>();
+
+        if (baselines) {
+            for (auto &[suite, suite_cases] : connected) {
+                keys->merge(baseline_keys(target, suite, suite_cases));
+            }
+        }
+
+        // queued before the cases, so no case can wait on it from a worker
+        // it needs
+        auto precompile
+            = [&, time_trace]() -> std::optional<precompiled_source> {
+            if (!args.pch) {
+                return {};
+            }
+
+            return precompiled_source{target, time_trace};
+        };
+
+        pending_pch pch = pool.submit(precompile).share();
+        pchs.push_back(pch);
+
+        // a PCH already parses each case body only once
+        auto slices = args.slice && !args.pch
+                          ? std::make_shared<const sliced_source>(target.source)
+                          : nullptr;
+
+        auto outside = r::count_if(cases, [&](auto &tc) {
+            return !declared_in_source(target, tc);
+        });
+
+        if (slices && outside > 0) {
+            log_warning("cases declared outside the source are compiled "
+                        "without slicing",
+                        "source",
+                        target.source,
+                        "cases",
+                        outside);
+        }
+
+        // everything done with a case's run, however it was compiled
+        auto finish
+            = [&args, &target, metrics, baselines, keys, retention](
+                  testcase_run run) {
+                  if (baselines && !run.samples.empty()) {
+                      compare_to_baseline(args,
+                                          *baselines,
+                                          keys->at({run.tc.file, run.tc.line}),
+                                          run);
+                  }
+
+                  log_result(run);
+
+                  if (metrics) {
+                      metrics->add_case(case_metrics::of(target, run));
+                  }
+
+                  // finished cases can wait a long time to be written if an
+                  // earlier one is slow
+                  retain(run, retention);
+
+                  return run;
+              };
+
+        auto run_alone
+            = [&args, &target, &run_hotspots, memory, pch, slices, finish](
+                  const test_case &tc) {
+                  return finish(run_case(
+                      args, target, tc, run_hotspots, pch, slices, memory));
+              };
+
+        // per-case time traces and costs can't be split out of a batch
+        auto batch_size = args.hotspots > 0 || baselines ? 1 : args.batch;
+
+        using batch_member
+            = std::pair<test_case,
+                        std::shared_ptr<std::promise<testcase_run>>>;
+
+        std::vector<batch_member> batch;
+
+        auto settle_alone = [run_alone](test_case tc, auto promise) {
+            try {
+                promise->set_value(run_alone(tc));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        };
+
+        // undecided cases are queued again, alone, from the worker
+        auto run_batched = [&args,
+                            &target,
+                            &pool,
+                            memory,
+                            pch,
+                            slices,
+                            finish,
+                            settle_alone](std::vector<batch_member> members) {
+            std::size_t settled = 0;
+
+            try {
+                auto runs = run_batch(
+                    args,
+                    target,
+                    members | rv::keys | r::to<std::vector>(),
+                    pch,
+                    slices,
+                    memory);
+
+                for (; settled < members.size(); settled++) {
+                    auto &[tc, promise] = members[settled];
+
+                    if (runs[settled]) {
+                        promise->set_value(finish(*runs[settled]));
+                        continue;
+                    }
+
+                    pool.submit([settle_alone, tc = tc, promise = promise] {
+                        settle_alone(tc, promise);
+                    });
+                }
+            } catch (...) {
+                for (; settled < members.size(); settled++) {
+                    members[settled].second->set_exception(
+                        std::current_exception());
+                }
+            }
+        };
+
+        auto flush_batch = [&] {
+            if (batch.size() == 1) {
+                pool.submit([settle_alone, member = batch.front()] {
+                    settle_alone(member.first, member.second);
+                });
+            } else if (!batch.empty()) {
+                pool.submit([run_batched, members = std::move(batch)] {
+                    run_batched(members);
+                });
+            }
+
+            batch.clear();
+        };
+
+        for (auto &[suite, suite_cases] : connected) {
+            auto queued = scheduled_suite{suite};
+
+            for (auto &tc : suite_cases) {
+                if (batch_size > 1
+                    && tc.type == comp_test::test_type::MUST_STATIC_ASSERT) {
+                    auto promise
+                        = std::make_shared<std::promise<testcase_run>>();
+                    queued.cases.push_back(promise->get_future());
+                    batch.emplace_back(tc, promise);
+
+                    if (batch.size() == batch_size) {
+                        flush_batch();
+                    }
+
+                    continue;
+                }
+
+                queued.cases.push_back(
+                    pool.submit([run_alone, tc] { return run_alone(tc); }));
+            }
+
+            scheduled.push_back(std::move(queued));
+        }
+
+        flush_batch();
+    }
+
+    for (auto &queued : scheduled) {
+        auto suite_run = test_suite_run{queued.suite};
+
+        if (out) {
+            out->begin_suite(suite_run);
+        }
+
+        for (auto &pending : queued.cases) {
+            auto result = pending.get();
+            suite_run.add(result);
+
+            // written as soon as it's done, and compiler output is freed
+            if (out) {
+                auto span = trace_span{"junit::write", "runner"};
+                out->add_case(suite_run, result);
+            }
+        }
+
+        if (out) {
+            out->end_suite();
+        }
+
+        suite_runs.push_back(suite_run);
+    }
+
+    for (auto &pch : pchs) {
+        pch.wait();
+    }
+
+    if (args.hotspots > 0) {
+        log("template hotspots for the whole run",
+            "slowest",
+            run_hotspots.top(args.hotspots)
+                | rv::transform(&template_hotspot::to_string));
+    }
+
+    return std::tuple{suite_runs, discovery_failed};
+}
+
+/**
+ * Re-run the cases of every target whose source or included headers are
+ * saved, until killed
+ *
+ * The worker pool stays up between runs, and targets that didn't change
+ * aren't rediscovered.  Results go to the log as each case finishes - the
+ * JUnit report only covers the first run.  Each run's temp files are removed
+ * once it's done.
+ */
+void watch(const args &args,
+           std::vector<test_target> targets,
+           worker_pool &pool,
+           memory_limits *memory) {
+    inotify_watcher watcher;
+
+    if (!watcher.ok()) {
+        return;
+    }
+
+    // a prebuilt info binary goes stale with the first edit
+    for (auto &target : targets) {
+        target.info_binary = {};
+    }
+
+    std::vector<std::set<bfs::path>> inputs(targets.size());
+
+    auto refresh_inputs = [&](std::size_t i) {
+        inputs[i].clear();
+
+        for (auto &file : included_files(targets[i])) {
+            watcher.add(file);
+            inputs[i].insert(inotify_watcher::resolve(file));
+        }
+    };
+
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        refresh_inputs(i);
+    }
+
+    std::optional<junit> no_junit;
+
+    while (true) {
+        log("watching for changes", "files", watcher.size());
+
+        auto changed = watcher.wait();
+
+        if (changed.empty()) {
+            return; // poll failed
+        }
+
+        std::vector<std::size_t> affected;
+
+        for (std::size_t i = 0; i < targets.size(); i++) {
+            if (r::any_of(changed, [&](auto &file) {
+                    return inputs[i].count(file) > 0;
+                })) {
+                affected.push_back(i);
+            }
+        }
+
+        log("changed",
+            "files",
+            changed | rv::transform([](auto &file) { return file.native(); }),
+            "sources to re-run",
+            affected.size());
+
+        auto rerun = affected
+                     | rv::transform([&](auto i) { return targets[i]; })
+                     | r::to<std::vector>();
+
+        {
+            // every re-run would otherwise leave its temp files behind
+            auto scratch = scratch_directory{};
+
+            auto [suite_runs, discovery_failed] = run_tests(
+                args, rerun, pool, memory, nullptr, nullptr, no_junit);
+
+            auto sum = [&](auto count) {
+                return r::accumulate(suite_runs | rv::transform(count), 0L);
+            };
+
+            log(discovery_failed ? "run done - some sources failed to compile"
+                                 : "run done",
+                "passed",
+                sum([](auto &run) { return run.passed(); }),
+                "failed",
+                sum([](auto &run) { return run.failed(); }),
+                "errors",
+                sum([](auto &run) { return run.errors(); }));
+        }
+
+        // a save can add or remove includes
+        for (auto i : affected) {
+            refresh_inputs(i);
+        }
     }
 }
 
 } // namespace dhagedorn::comp_test::impl
 
 int main(int argc, char **argv) {
-    dhagedorn::comp_test::impl::log("env",
-                                    "bin",
-                                    argv[0],
-                                    "pwd",
-                                    boost::filesystem::current_path().native());
-
     auto args = dhagedorn::comp_test::impl::parse_opts(argc, argv);
 
+    auto stats = dhagedorn::comp_test::impl::run_stats{
+        args.compdb ? *args.compdb : args.source};
+
+    dhagedorn::comp_test::impl::log_set_level(args.level);
+    dhagedorn::comp_test::impl::log_enable_colour(args.colour);
+
+    if (args.trace) {
+        auto &tracer = dhagedorn::comp_test::impl::tracer::instance();
+        tracer.enable(*args.trace);
+        tracer.name_thread("main");
+    }
+
+    dhagedorn::comp_test::impl::log_debug(
+        "env",
+        "bin",
+        argv[0],
+        "pwd",
+        boost::filesystem::current_path().native());
+
     args.print();
 
-    auto [suites, cases] = get_tests(args);
+    // opened before discovery so an early exit still leaves a valid test.xml
+    std::optional<dhagedorn::comp_test::impl::junit> out;
 
-    dhagedorn::comp_test::impl::log(
-        "test info",
-        "suites",
-        suites | ranges::views::transform([](auto &suite) {
-            return suite.symbol;
-        }),
-        "cases' suites",
-        cases | ranges::views::transform([](auto &tc) {
-            return tc.test_suite_symbol();
-        }));
+    if (args.junit) {
+        out.emplace(*args.junit);
+    }
+
+    auto targets
+        = args.compdb
+              ? dhagedorn::comp_test::impl::read_compdb(*args.compdb,
+                                                        args.files)
+              : std::vector<dhagedorn::comp_test::impl::test_target>{{
+                  args.source,
+                  args.compiler,
+                  args.compiler_args,
+                  args.info_binary,
+              }};
+
+    if (targets.empty()) {
+        dhagedorn::comp_test::impl::log_error(
+            "no sources to run", "compdb", args.compdb, "files", args.files);
+    }
 
-    //
+    auto pool = dhagedorn::comp_test::impl::worker_pool{args.jobs};
 
-    auto by_suite = dhagedorn::comp_test::impl::connect(suites, cases);
+    // --jobs is then the most compiles at once, if the jobserver has tokens
+    auto &jobserver = dhagedorn::comp_test::impl::jobserver::instance();
 
-    auto runs_by_suite = dhagedorn::comp_test::impl::run_tests(args, by_suite);
+    if (args.jobserver) {
+        jobserver.connect_fifo(*args.jobserver);
+    } else {
+        jobserver.connect_from_makeflags();
+    }
 
-    write_junit(args, runs_by_suite);
+    // --jobs is then the most compiles at once, if memory allows
+    std::optional<dhagedorn::comp_test::impl::memory_limits> memory;
 
-    auto passed = ranges::all_of(runs_by_suite, [](auto &suite_run) {
-        return suite_run.failed() == 0 && suite_run.errors() == 0;
-    });
+    if (args.memory_aware) {
+        memory.emplace(static_cast<long>(args.memory_reserve_mb) * 1024);
+
+        if (args.memory_profile) {
+            memory->profile.load(*args.memory_profile);
+        }
+    }
+
+    auto *limits = memory ? &*memory : nullptr;
+
+    std::optional<dhagedorn::comp_test::impl::run_metrics> metrics;
+
+    if (args.metrics) {
+        metrics.emplace(args.jobs);
+    }
+
+    std::optional<dhagedorn::comp_test::impl::run_baselines> baselines;
+
+    if (args.write_baseline || args.baseline) {
+        baselines.emplace();
+
+        if (args.write_baseline) {
+            baselines->written.emplace();
+        }
+
+        if (args.baseline) {
+            baselines->compared.emplace(*args.baseline,
+                                        args.regression_threshold / 100);
+        }
+    }
+
+    auto [runs_by_suite, discovery_failed]
+        = dhagedorn::comp_test::impl::run_tests(
+            args,
+            targets,
+            pool,
+            limits,
+            metrics ? &*metrics : nullptr,
+            baselines ? &*baselines : nullptr,
+            out);
+
+    if (metrics) {
+        metrics->write(*args.metrics);
+    }
+
+    if (baselines && baselines->written) {
+        baselines->written->save(*args.write_baseline);
+    }
+
+    if (baselines && baselines->compared) {
+        baselines->compared->log_summary();
+    }
+
+    if (memory && args.memory_profile) {
+        memory->profile.save(*args.memory_profile);
+    }
+
+    dhagedorn::comp_test::impl::tracer::instance().write();
+
+    if (args.stats) {
+        stats.write(*args.stats, runs_by_suite);
+    }
+
+    if (args.watch) {
+        dhagedorn::comp_test::impl::watch(args, targets, pool, limits);
+    }
+
+    auto passed = !targets.empty() && !discovery_failed
+                  && ranges::all_of(runs_by_suite, [](auto &suite_run) {
+                         return suite_run.failed() == 0
+                                && suite_run.errors() == 0;
+                     });
 
     return passed ? 0 : 1;
 }
\ No newline at end of file
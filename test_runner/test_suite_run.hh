@@ -13,32 +13,48 @@ namespace r = ranges;
 
 using namespace std::chrono_literals;
 
+/**
+ * What is kept of a testcase_run once it has been reported - the full
+ * compiler output is dropped as soon as the case is written out
+ */
+struct testcase_summary {
+    test_case_result result;
+    std::chrono::milliseconds duration;
+};
+
 struct test_suite_run {
     comp_test::test_suite test_suite;
-    std::vector<testcase_run> case_runs;
+    std::vector<testcase_summary> case_results;
+
+    void add(const testcase_run &run) {
+        case_results.push_back({run.result(), run.duration});
+    }
+
+    auto tests() const { return case_results.size(); }
 
     auto passed() const {
-        return r::count_if(case_runs, [](const auto &run) {
-            return run.result() == test_case_result::pass;
+        return r::count_if(case_results, [](const auto &summary) {
+            return summary.result == test_case_result::pass;
         });
     }
 
     auto failed() const {
-        return r::count_if(case_runs, [](const auto &run) {
-            return run.result() == test_case_result::fail;
+        return r::count_if(case_results, [](const auto &summary) {
+            return summary.result == test_case_result::fail;
         });
     }
 
     auto errors() const {
-        return r::count_if(case_runs, [](const auto &run) {
-            return run.result() == test_case_result::error;
+        return r::count_if(case_results, [](const auto &summary) {
+            return summary.result == test_case_result::error;
         });
     }
 
     auto duration() const {
         return r::accumulate(
-            case_runs | rv::transform([](auto &r) { return r.duration; }), 0ms);
+            case_results | rv::transform([](auto &r) { return r.duration; }),
+            0ms);
     }
 };
 
-} // namespace dhagedorn::comp_test::impl
\ No newline at end of file
+} // namespace dhagedorn::comp_test::impl
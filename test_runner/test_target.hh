@@ -0,0 +1,25 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/** one source file of test cases, and how to compile it */
+struct test_target {
+    std::string source;
+    std::string compiler;
+    std::vector<std::string> compiler_args;
+    // prebuilt info binary (cc_comp_test) - otherwise one is compiled from
+    // source to discover its cases
+    std::optional<std::string> info_binary;
+    // directory to compile in - the runner's own if empty
+    bfs::path directory = {};
+};
+
+} // namespace dhagedorn::comp_test::impl
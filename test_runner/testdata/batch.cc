@@ -0,0 +1,41 @@
+#include <type_traits>
+
+template <typename T>
+void to_string(T) {
+    static_assert(std::is_integral<T>::value, "type not supported");
+}
+
+namespace _test_suite_1 {
+template <typename TestCase>
+void _test_case_2() {
+    to_string(1.0);
+}
+
+template <typename TestCase>
+void _test_case_3() {
+    to_string(2.0);
+    static_assert(sizeof(TestCase) == 0, "unrelated");
+}
+
+template <typename TestCase>
+void _test_case_4() {
+    static_assert(sizeof(TestCase) == 0, "own message");
+}
+
+template <typename TestCase>
+void _test_case_5() {
+    to_string(TestCase::line);
+}
+} // namespace _test_suite_1
+
+struct TestCaseInstantiation_0 { static constexpr unsigned line = 1; };
+struct TestCaseInstantiation_1 { static constexpr unsigned line = 2; };
+struct TestCaseInstantiation_2 { static constexpr unsigned line = 3; };
+struct TestCaseInstantiation_3 { static constexpr unsigned line = 4; };
+
+int main() {
+    _test_suite_1::_test_case_2<TestCaseInstantiation_0>();
+    _test_suite_1::_test_case_3<TestCaseInstantiation_1>();
+    _test_suite_1::_test_case_4<TestCaseInstantiation_2>();
+    _test_suite_1::_test_case_5<TestCaseInstantiation_3>();
+}
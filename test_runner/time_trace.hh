@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+
+#include "log.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+namespace pt = boost::property_tree;
+
+/**
+ * One complete ("ph": "X") event from clang's -ftime-trace output
+ *
+ * Times are in microseconds, relative to the start of the compiler process
+ */
+struct time_trace_event {
+    std::string name;
+    std::string detail;
+    double ts;
+    double dur;
+};
+
+/**
+ * Read the events clang writes with -ftime-trace
+ *
+ * Skips metadata and clang's own per-name "Total ..." summary events -
+ * those aren't points on a timeline
+ */
+inline std::vector<time_trace_event> read_time_trace(const bfs::path &path) {
+    std::vector<time_trace_event> events;
+
+    pt::ptree root;
+
+    try {
+        pt::read_json(path.native(), root);
+    } catch (pt::json_parser_error &err) {
+        log_warning("could not read time trace",
+                    "path",
+                    path.native(),
+                    "error",
+                    err.what());
+        return events;
+    }
+
+    auto trace_events = root.get_child_optional("traceEvents");
+
+    if (!trace_events) {
+        return events;
+    }
+
+    for (auto &[_, event] : *trace_events) {
+        auto name = event.get<std::string>("name", "");
+
+        if (event.get<std::string>("ph", "") != "X"
+            || name.rfind("Total ", 0) == 0) {
+            continue;
+        }
+
+        events.push_back({
+            name,
+            event.get<std::string>("args.detail", ""),
+            event.get<double>("ts", 0),
+            event.get<double>("dur", 0),
+        });
+    }
+
+    return events;
+}
+
+} // namespace dhagedorn::comp_test::impl
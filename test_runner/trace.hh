@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "fmt/core.h"
+
+#include "log.hh"
+#include "util.hh"
+#include "time_trace.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/**
+ * Collects a timeline of the run as Chrome trace events
+ *
+ * See
+ * https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+ *
+ * Open the written file in https://ui.perfetto.dev or chrome://tracing.  Each
+ * thread that does work shows up as its own track, so idle time between
+ * cases is visible as gaps.
+ */
+class tracer {
+public:
+    using clock = std::chrono::steady_clock;
+    using trace_args = std::vector<std::pair<std::string, std::string>>;
+
+    static tracer &instance() {
+        static tracer t;
+        return t;
+    }
+
+    void enable(bfs::path path) {
+        _path = path;
+        _enabled = true;
+    }
+
+    bool enabled() const { return _enabled; }
+
+    /** small, stable id for the calling thread - used as its track */
+    static unsigned thread_id() {
+        static std::atomic<unsigned> next{0};
+        thread_local unsigned id = next++;
+        return id;
+    }
+
+    void name_thread(const std::string &name) {
+        if (!_enabled) {
+            return;
+        }
+
+        _push(fmt::format(
+            R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+            thread_id(),
+            json_escape(name)));
+    }
+
+    void complete(const std::string &name,
+                  const std::string &category,
+                  clock::time_point start,
+                  clock::time_point end,
+                  const trace_args &args = {}) {
+        if (!_enabled) {
+            return;
+        }
+
+        _complete(name, category, _us(start), _us(end) - _us(start), args);
+    }
+
+    /**
+     * Nest the events of a clang -ftime-trace file under the current thread's
+     * track, with the compiler having started at start
+     */
+    void merge_time_trace(const bfs::path &path, clock::time_point start) {
+        if (!_enabled) {
+            return;
+        }
+
+        auto offset = _us(start);
+
+        for (auto &event : read_time_trace(path)) {
+            _complete(event.name,
+                      "clang",
+                      offset + event.ts,
+                      event.dur,
+                      event.detail.empty()
+                          ? trace_args{}
+                          : trace_args{{"detail", event.detail}});
+        }
+    }
+
+    void write() {
+        if (!_enabled) {
+            return;
+        }
+
+        std::lock_guard lock{_mutex};
+
+        std::ofstream fout{_path.native()};
+
+        if (!fout.is_open()) {
+            log_error("could not write trace", "path", _path.native());
+            return;
+        }
+
+        fout << R"({"displayTimeUnit":"ms","traceEvents":[)" << '\n';
+
+        for (std::size_t i = 0; i < _events.size(); i++) {
+            fout << _events[i] << (i + 1 < _events.size() ? ",\n" : "\n");
+        }
+
+        fout << "]}\n";
+    }
+
+private:
+    tracer()
+        : _origin{clock::now()} {}
+
+    double _us(clock::time_point t) const {
+        return std::chrono::duration<double, std::micro>(t - _origin).count();
+    }
+
+    void _complete(const std::string &name,
+                   const std::string &category,
+                   double ts,
+                   double dur,
+                   const trace_args &args) {
+        std::string json_args;
+
+        for (auto &[k, v] : args) {
+            json_args += fmt::format(R"({}"{}":"{}")",
+                                     json_args.empty() ? "" : ",",
+                                     json_escape(k),
+                                     json_escape(v));
+        }
+
+        _push(fmt::format(
+            R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{},"args":{{{}}}}})",
+            json_escape(name),
+            json_escape(category),
+            ts,
+            dur,
+            thread_id(),
+            json_args));
+    }
+
+    void _push(std::string event) {
+        std::lock_guard lock{_mutex};
+        _events.push_back(std::move(event));
+    }
+
+    bool _enabled = false;
+    bfs::path _path;
+    clock::time_point _origin;
+    std::mutex _mutex;
+    std::vector<std::string> _events;
+};
+
+/**
+ * Records the scope it lives in as one complete event on the calling
+ * thread's track
+ */
+class trace_span {
+public:
+    trace_span(std::string name,
+               std::string category,
+               tracer::trace_args args = {})
+        : _name{std::move(name)}
+        , _category{std::move(category)}
+        , _args{std::move(args)}
+        , _start{tracer::clock::now()} {}
+
+    trace_span(const trace_span &) = delete;
+    trace_span &operator=(const trace_span &) = delete;
+
+    ~trace_span() {
+        tracer::instance().complete(
+            _name, _category, _start, tracer::clock::now(), _args);
+    }
+
+    tracer::clock::time_point start() const { return _start; }
+
+private:
+    std::string _name;
+    std::string _category;
+    tracer::trace_args _args;
+    tracer::clock::time_point _start;
+};
+
+} // namespace dhagedorn::comp_test::impl
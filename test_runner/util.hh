@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cctype>
 #include <initializer_list>
 #include <optional>
+#include <stdexcept>
+#include <string>
 
+#include "fmt/core.h"
 #include "range/v3/all.hpp"
 
 namespace dhagedorn::comp_test::impl {
@@ -52,6 +56,64 @@ private:
     FCT _f;
 };
 
+/** escape value for use inside a JSON string */
+inline std::string json_escape(const std::string &value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+
+    for (auto c : value) {
+        switch (c) {
+            case '"':
+                escaped += R"(\")";
+                break;
+            case '\\':
+                escaped += R"(\\)";
+                break;
+            case '\n':
+                escaped += R"(\n)";
+                break;
+            case '\t':
+                escaped += R"(\t)";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+
+    return escaped;
+}
+
+/**
+ * an integer literal as written - 1024, 1024u, 1'024 - empty if it isn't
+ * one, or is too big for an unsigned long
+ */
+inline std::optional<unsigned long> parse_count(const std::string &literal) {
+    std::string digits;
+
+    for (auto c : literal) {
+        if (c >= '0' && c <= '9') {
+            digits += c;
+        } else if (!std::isspace(static_cast<unsigned char>(c))
+                   && std::string{"uUlL'"}.find(c) == std::string::npos) {
+            return {};
+        }
+    }
+
+    if (digits.empty()) {
+        return {};
+    }
+
+    try {
+        return std::stoul(digits);
+    } catch (const std::out_of_range &) {
+        return {};
+    }
+}
+
 template <typename RESULT, typename TEST, typename... REST>
 inline constexpr auto when(TEST &&test, RESULT &&result, REST... rest) {
     if (test) {
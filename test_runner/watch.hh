@@ -0,0 +1,316 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "compiler.hh"
+#include "log.hh"
+#include "test_target.hh"
+
+namespace dhagedorn::comp_test::impl {
+
+namespace bfs = boost::filesystem;
+
+/**
+ * Paths in a make rule, as written by -M - everything after the first ':',
+ * with line continuations and escaped spaces undone
+ */
+inline std::vector<std::string>
+make_rule_prerequisites(const std::string &rule) {
+    std::vector<std::string> paths;
+
+    auto colon = rule.find(": ");
+
+    if (colon == std::string::npos) {
+        return paths;
+    }
+
+    std::string path;
+
+    for (auto i = colon + 1; i < rule.size(); i++) {
+        auto c = rule[i];
+
+        if (c == '\\' && i + 1 < rule.size()) {
+            auto next = rule[i + 1];
+
+            if (next == '\n') {
+                i++;
+                c = ' ';
+            } else if (next == ' ' || next == '\\') {
+                path += next;
+                i++;
+                continue;
+            }
+        } else if (c == '$' && i + 1 < rule.size() && rule[i + 1] == '$') {
+            path += '$';
+            i++;
+            continue;
+        }
+
+        if (c == ' ' || c == '\n' || c == '\t') {
+            if (!path.empty()) {
+                paths.push_back(path);
+                path.clear();
+            }
+        } else {
+            path += c;
+        }
+    }
+
+    if (!path.empty()) {
+        paths.push_back(path);
+    }
+
+    return paths;
+}
+
+/**
+ * The source of target, and every non-system header it includes
+ *
+ * Asks the compiler with -MM, using target's own flags, so the list matches
+ * what a case compile would read.  Just the source if that fails.
+ */
+inline std::vector<bfs::path> included_files(const test_target &target) {
+    auto base = target.directory.empty() ? bfs::current_path()
+                                         : target.directory;
+
+    // target's own dependency file flags would send -MM's output there
+    std::vector<std::string> args;
+
+    for (std::size_t i = 0; i < target.compiler_args.size(); i++) {
+        auto &arg = target.compiler_args[i];
+
+        if (arg == "-MF" || arg == "-MT" || arg == "-MQ") {
+            i++;
+        } else if (arg != "-MD" && arg != "-MMD") {
+            args.push_back(arg);
+        }
+    }
+
+    args.push_back("-MM");
+
+    auto deps = bfs::temp_directory_path()
+                / bfs::unique_path().replace_extension(".d");
+
+    auto result = compiler{target.compiler, args, false, target.directory}
+                      .compile(target.source, deps);
+
+    std::vector<bfs::path> files = {bfs::absolute(target.source)};
+
+    std::ifstream fin{deps.native()};
+
+    if (!result.compiled || !fin.is_open()) {
+        log_warning(
+            "could not list included headers - watching the source only",
+            "source",
+            target.source,
+            "diagnostics",
+            result.diagnostics | rv::transform(&compiler_diagnostic::original));
+        return files;
+    }
+
+    std::stringstream rule;
+    rule << fin.rdbuf();
+
+    for (auto &path : make_rule_prerequisites(rule.str())) {
+        files.push_back(bfs::absolute(path, base));
+    }
+
+    bfs::remove(deps);
+
+    return files;
+}
+
+/**
+ * Watches files for writes with inotify
+ *
+ * Each file's directory is watched rather than the file itself, so saves that
+ * replace the file (write to a temp file, then rename over it) are seen, and
+ * the file stays watched afterwards.  Paths are resolved through symlinks
+ * first - Bazel runfiles are symlinks to the files actually edited.
+ */
+class inotify_watcher {
+public:
+    inotify_watcher()
+        : _fd{inotify_init1(IN_CLOEXEC)} {
+        if (_fd < 0) {
+            log_error("could not start inotify", "error", strerror(errno));
+        }
+    }
+
+    inotify_watcher(const inotify_watcher &) = delete;
+    inotify_watcher &operator=(const inotify_watcher &) = delete;
+
+    ~inotify_watcher() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    bool ok() const { return _fd >= 0; }
+
+    /** the watched path for file, as returned from wait() */
+    static bfs::path resolve(const bfs::path &file) {
+        return bfs::weakly_canonical(file);
+    }
+
+    void add(const bfs::path &file) {
+        auto path = resolve(file);
+
+        if (!_files.insert(path).second) {
+            return;
+        }
+
+        auto dir = path.parent_path();
+
+        if (_watched_dirs.count(dir)) {
+            return;
+        }
+
+        auto wd
+            = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+        if (wd < 0) {
+            log_warning("could not watch directory",
+                        "dir",
+                        dir.native(),
+                        "error",
+                        strerror(errno));
+            return;
+        }
+
+        _dirs[wd] = dir;
+        _watched_dirs.insert(dir);
+    }
+
+    std::size_t size() const { return _files.size(); }
+
+    /**
+     * Block until a watched file is written, then return every watched file
+     * written until things go quiet - editors and formatters often write a
+     * file more than once per save
+     */
+    std::set<bfs::path> wait() {
+        std::set<bfs::path> changed;
+        auto timeout = -1;
+
+        while (true) {
+            pollfd fds{_fd, POLLIN, 0};
+            auto ready = ::poll(&fds, 1, timeout);
+
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (ready < 0) {
+                log_error("inotify poll failed", "error", strerror(errno));
+                return changed;
+            }
+
+            if (ready == 0) {
+                return changed;
+            }
+
+            _read(changed);
+
+            if (!changed.empty()) {
+                timeout = _quiet_ms;
+            }
+        }
+    }
+
+private:
+    constexpr static int _quiet_ms = 100;
+
+    int _fd;
+    std::map<int, bfs::path> _dirs;
+    std::set<bfs::path> _watched_dirs;
+    std::set<bfs::path> _files;
+
+    void _read(std::set<bfs::path> &changed) {
+        alignas(inotify_event) char buf[4096];
+
+        auto size = ::read(_fd, buf, sizeof(buf));
+
+        for (ssize_t offset = 0; offset < size;) {
+            auto *event = reinterpret_cast<const inotify_event *>(buf + offset);
+
+            auto dir = _dirs.find(event->wd);
+
+            if (event->len > 0 && dir != _dirs.end()) {
+                auto path = dir->second / event->name;
+
+                if (_files.count(path)) {
+                    changed.insert(path);
+                }
+            }
+
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+};
+
+/**
+ * A directory for one re-run's temp files, removed with everything in it
+ * when the run is done
+ *
+ * Copies of the source, objects, PCHs, info binaries and spilled output all
+ * go to temp_directory_path(), which is $TMPDIR - so it's pointed here while
+ * this lives, for the runner and the compilers it starts.  Only while the
+ * worker pool is idle - nothing may be reading $TMPDIR.
+ */
+class scratch_directory {
+public:
+    scratch_directory()
+        : _path{bfs::temp_directory_path()
+                / bfs::unique_path("comp_test-%%%%-%%%%-%%%%")} {
+        if (auto tmpdir = std::getenv("TMPDIR")) {
+            _previous = tmpdir;
+        }
+
+        bfs::create_directories(_path);
+        ::setenv("TMPDIR", _path.c_str(), 1);
+    }
+
+    scratch_directory(const scratch_directory &) = delete;
+    scratch_directory &operator=(const scratch_directory &) = delete;
+
+    ~scratch_directory() {
+        if (_previous) {
+            ::setenv("TMPDIR", _previous->c_str(), 1);
+        } else {
+            ::unsetenv("TMPDIR");
+        }
+
+        boost::system::error_code error;
+        bfs::remove_all(_path, error);
+
+        if (error) {
+            log_warning("could not remove a run's temp files",
+                        "directory",
+                        _path.native(),
+                        "error",
+                        error.message());
+        }
+    }
+
+private:
+    bfs::path _path;
+    std::optional<std::string> _previous;
+};
+
+} // namespace dhagedorn::comp_test::impl